@@ -0,0 +1,126 @@
+/*
+ * ButtonScanner.cpp - Library for debouncing buttons from a timer tick.
+ * Released into the public domain.
+ */
+
+#include "ButtonScanner.h"
+#include "Arduino.h"
+
+// stops the compiler from moving queue accesses across the index updates
+#define MEMORY_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+
+ButtonScanner::ButtonScanner(const uint8_t *pins, uint8_t count)
+{
+    _pins = pins;
+    _count = count > BUTTON_SCANNER_MAX_BUTTONS ? BUTTON_SCANNER_MAX_BUTTONS : count;
+
+    _count0 = 0;
+    _count1 = 0;
+    _state = 0;
+    _chord = 0;
+    _longPressed = 0;
+    _head = 0;
+    _tail = 0;
+    _dropped = 0;
+}
+
+void ButtonScanner::begin()
+{
+    _inputRegister = portInputRegister(digitalPinToPort(_pins[0]));
+
+    for (uint8_t i = 0; i < _count; i++) {
+        pinMode(_pins[i], INPUT);
+        _bitMasks[i] = digitalPinToBitMask(_pins[i]);
+        _heldTicks[i] = 0;
+    }
+}
+
+void ButtonScanner::onTick()
+{
+    // one read samples every button
+    uint8_t port = *_inputRegister;
+
+    uint8_t sample = 0;
+    for (uint8_t i = 0; i < _count; i++) {
+        if (port & _bitMasks[i]) {
+            sample |= (1 << i);
+        }
+    }
+
+    /*
+     * Two-bit vertical counter per button: it counts the consecutive
+     * samples that differ from the debounced state and is reset by any
+     * sample that agrees with it. The state toggles when it wraps.
+     */
+    uint8_t delta = sample ^ _state;
+    _count1 = (_count1 ^ _count0) & delta;
+    _count0 = ~_count0 & delta;
+    uint8_t toggle = delta & ~(_count0 | _count1);
+    _state ^= toggle;
+
+    for (uint8_t i = 0; i < _count; i++) {
+        uint8_t bit = (1 << i);
+
+        if (toggle & bit) {
+            if (_state & bit) {
+                _chord |= bit;
+                push(BUTTON_EVENT_PRESS, bit);
+            }
+            else {
+                push(BUTTON_EVENT_RELEASE, bit);
+            }
+            _heldTicks[i] = 0;
+        }
+        else if ((_state & bit) && !(_longPressed & bit)) {
+            if (++_heldTicks[i] >= BUTTON_SCANNER_LONG_PRESS_TICKS) {
+                _longPressed |= bit;
+                push(BUTTON_EVENT_LONG_PRESS, bit);
+            }
+        }
+    }
+
+    if (toggle != 0 && _state == 0) {
+        push(BUTTON_EVENT_CHORD, _chord);
+        _chord = 0;
+        _longPressed = 0;
+    }
+}
+
+void ButtonScanner::push(uint8_t type, uint8_t buttons)
+{
+    uint8_t next = (_head + 1) & (BUTTON_SCANNER_QUEUE_SIZE - 1);
+    if (next == _tail) {
+        _dropped++;
+        return;
+    }
+
+    _events[_head].type = type;
+    _events[_head].buttons = buttons;
+    _events[_head].millis = millis();
+    MEMORY_BARRIER();
+    _head = next;
+}
+
+bool ButtonScanner::readEvent(button_event_t *event)
+{
+    if (_tail == _head) {
+        return false;
+    }
+
+    MEMORY_BARRIER();
+    *event = _events[_tail];
+    MEMORY_BARRIER();
+    _tail = (_tail + 1) & (BUTTON_SCANNER_QUEUE_SIZE - 1);
+
+    return true;
+}
+
+uint8_t ButtonScanner::getPressed()
+{
+    return _state;
+}
+
+uint8_t ButtonScanner::getDroppedEvents()
+{
+    return _dropped;
+}
@@ -0,0 +1,87 @@
+/*
+ * ButtonScanner.h - Library for debouncing buttons from a timer tick.
+ * Released into the public domain.
+ */
+
+#ifndef ButtonScanner_h
+#define ButtonScanner_h
+
+#include "Arduino.h"
+
+#define BUTTON_SCANNER_MAX_BUTTONS 8
+
+// must be a power of two, at most 128
+#ifndef BUTTON_SCANNER_QUEUE_SIZE
+#define BUTTON_SCANNER_QUEUE_SIZE 8
+#endif
+
+// ticks a button must stay down to count as a long press
+#ifndef BUTTON_SCANNER_LONG_PRESS_TICKS
+#define BUTTON_SCANNER_LONG_PRESS_TICKS 1000
+#endif
+
+enum button_event_type_t {
+    BUTTON_EVENT_PRESS,
+    BUTTON_EVENT_RELEASE,
+    BUTTON_EVENT_LONG_PRESS,
+
+    // all buttons are up again: buttons has every button that went down
+    // since the first one was pressed (a single bit for a plain click)
+    BUTTON_EVENT_CHORD
+};
+
+struct button_event_t {
+    uint8_t type;
+    uint8_t buttons;        // bit 0 is the first button
+    unsigned long millis;   // when the event was detected
+};
+
+/*
+ * All buttons must be on the same port, so one read of its PINx register
+ * samples them together. Call onTick() from a timer interrupt: a button
+ * changes state after four equal samples in a row (vertical counters, so
+ * every button is debounced in a handful of instructions), and the
+ * resulting events are queued for the main loop to read.
+ */
+class ButtonScanner
+{
+    public:
+        ButtonScanner(const uint8_t *pins, uint8_t count);
+
+        void begin();
+
+        // call from the timer interrupt
+        void onTick();
+
+        // pops the oldest event, false if there is none
+        bool readEvent(button_event_t *event);
+
+        // debounced state, one bit per button
+        uint8_t getPressed();
+
+        // number of events lost because the queue was full
+        uint8_t getDroppedEvents();
+
+    private:
+        void push(uint8_t type, uint8_t buttons);
+
+        const uint8_t *_pins;
+        uint8_t _count;
+        volatile uint8_t *_inputRegister;
+        uint8_t _bitMasks[BUTTON_SCANNER_MAX_BUTTONS];
+
+        // debouncer, all touched by the interrupt only
+        uint8_t _count0;
+        uint8_t _count1;
+        volatile uint8_t _state;
+        uint8_t _chord;
+        uint8_t _longPressed;
+        uint16_t _heldTicks[BUTTON_SCANNER_MAX_BUTTONS];
+
+        button_event_t _events[BUTTON_SCANNER_QUEUE_SIZE];
+        volatile uint8_t _head; // written by the interrupt only
+        volatile uint8_t _tail; // written by readEvent() only
+        volatile uint8_t _dropped;
+};
+
+#endif
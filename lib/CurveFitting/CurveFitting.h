@@ -8,26 +8,269 @@
 #define CurveFitting_h
 
 #include "Arduino.h"
+#include "CurveModel.h"
+#include "ExponentialModel.h"
+#include "QuadraticModel.h"
+#include "PiecewiseLinearModel.h"
+#include <Profiler.h>
 
-class CurveFitting
+// time refine() may take by default
+#define CURVE_FITTING_REFINE_MICROS 50000
+
+/*
+ * Fits points with the model it is instantiated with, see CurveModel.h:
+ *
+ *   CurveFitter<ExponentialModel> fit;
+ */
+template <class Model>
+class CurveFitter
 {
     public:
-        CurveFitting();
-        void fitPoints(double points[][2], int n);
+        CurveFitter();
+        void fitPoints(curve_point_t *points, int n);
         double estimate(double x);
         bool isCurveFitted();
+        uint8_t getParamCount();
         double getEstimatedParameter(int parameter);
-        void setParams(double a, double b, double c);
+        void setParams(const double *params);
+
+        // x range estimate() is meant for, from the next setParams()
+        void setRange(double minX, double maxX);
+
+        /*
+         * Incremental fitting: points are added one at a time into
+         * caller-owned storage for up to capacity points, kept sorted
+         * by x and rounded to the ms. The parameters are re-estimated
+         * after every point.
+         */
+        void beginFit(curve_point_t *points, int capacity);
+        bool addPoint(double x, double y);
+        int getPointCount();
+
+        /*
+         * Improves the fitted parameters where the model can, within
+         * budgetMicros, and reports how they fit the points.
+         */
+        uint8_t refine(unsigned long budgetMicros = CURVE_FITTING_REFINE_MICROS);
+        void getFitQuality(fit_quality_t *quality);
+
+        Model &getModel();
 
     private:
-        void processMatrix(double a11, double a12, double a21, double a22, double b1, double b2, double *r1, double *r2);
-        void sort2DArray(double array[][2], int n);
-
-        // exponential parameters stored internally
-        double _curveFitted;
-        double _a;
-        double _b;
-        double _c;
+        void sortPoints(curve_point_t *points, int n);
+        void estimateParams();
+
+        bool _curveFitted;
+        uint8_t _refineSteps;
+        Model _model;
+
+        // points being fitted
+        curve_point_t *_points;
+        int _pointCount;
+        int _pointCapacity;
 };
 
+template <class Model>
+CurveFitter<Model>::CurveFitter()
+{
+    _curveFitted = false;
+    _refineSteps = 0;
+
+    _points = NULL;
+    _pointCount = 0;
+    _pointCapacity = 0;
+}
+
+template <class Model>
+void CurveFitter<Model>::fitPoints(curve_point_t *points, int n)
+{
+   PROFILE(PROFILE_FIT);
+
+   // sort array of points
+   sortPoints(points, n);
+
+   _points = points;
+   _pointCount = n;
+   _pointCapacity = n;
+
+   _model.reset();
+   for (int k=0; k<n; k++) {
+      _model.accumulate(_points, k);
+   }
+
+   estimateParams();
+}
+
+template <class Model>
+void CurveFitter<Model>::beginFit(curve_point_t *points, int capacity)
+{
+   _points = points;
+   _pointCount = 0;
+   _pointCapacity = capacity;
+   _model.reset();
+
+   _curveFitted = false;
+}
+
+/*
+ * Inserts the point in x order. A point that goes last, which is how
+ * calibration points arrive, is just accumulated by the model; one
+ * that goes anywhere else makes it start over.
+ */
+template <class Model>
+bool CurveFitter<Model>::addPoint(double x, double y)
+{
+   PROFILE(PROFILE_FIT);
+
+   if (_pointCount == _pointCapacity) {
+      return false;
+   }
+
+   curve_point_t point;
+   point.x = constrain(x + 0.5, 0, 65535);
+   point.y = constrain(y + 0.5, 0, 65535);
+
+   int k = _pointCount;
+   while (k > 0 && _points[k-1].x > point.x) {
+      _points[k] = _points[k-1];
+      k--;
+   }
+   _points[k] = point;
+   _pointCount++;
+
+   if (k == _pointCount - 1) {
+      _model.accumulate(_points, k);
+   }
+   else {
+      _model.reset();
+      for (int i=0; i<_pointCount; i++) {
+         _model.accumulate(_points, i);
+      }
+   }
+
+   estimateParams();
+   return true;
+}
+
+template <class Model>
+int CurveFitter<Model>::getPointCount()
+{
+   return _pointCount;
+}
+
+template <class Model>
+void CurveFitter<Model>::estimateParams()
+{
+   if (_pointCount < Model::MIN_POINTS) {
+      return;
+   }
+
+   // estimate() is for the points we have seen
+   _model.setRange(_points[0].x, _points[_pointCount-1].x);
+
+   if (_model.fit(_points, _pointCount)) {
+      _curveFitted = true;
+      _refineSteps = 0;
+   }
+}
+
+template <class Model>
+uint8_t CurveFitter<Model>::refine(unsigned long budgetMicros)
+{
+   PROFILE(PROFILE_FIT);
+
+   if (_curveFitted) {
+      _refineSteps = _model.refine(_points, _pointCount, budgetMicros);
+   }
+   return _refineSteps;
+}
+
+template <class Model>
+void CurveFitter<Model>::getFitQuality(fit_quality_t *quality)
+{
+   double sum = 0;
+   quality->maxResidual = 0;
+   for (int k=0; k<_pointCount; k++) {
+      double r = fabs(_points[k].y - _model.estimate(_points[k].x));
+      sum += r * r;
+      if (r > quality->maxResidual) {
+         quality->maxResidual = r;
+      }
+   }
+
+   quality->rmsResidual = _pointCount > 0 ? sqrt(sum / _pointCount) : 0;
+   quality->condition = _model.getCondition();
+   quality->refineSteps = _refineSteps;
+}
+
+template <class Model>
+bool CurveFitter<Model>::isCurveFitted()
+{
+    return _curveFitted;
+}
+
+template <class Model>
+void CurveFitter<Model>::setParams(const double *params)
+{
+   _model.setParams(params);
+
+   _curveFitted = true;
+}
+
+template <class Model>
+void CurveFitter<Model>::setRange(double minX, double maxX)
+{
+   _model.setRange(minX, maxX);
+}
+
+template <class Model>
+double CurveFitter<Model>::estimate(double x)
+{
+    PROFILE(PROFILE_ESTIMATE);
+
+    if (_curveFitted) {
+        return _model.estimate(x);
+    }
+
+    return 0;
+}
+
+template <class Model>
+uint8_t CurveFitter<Model>::getParamCount()
+{
+    return Model::PARAM_COUNT;
+}
+
+template <class Model>
+double CurveFitter<Model>::getEstimatedParameter(int parameter) {
+    if (_curveFitted) {
+        return _model.getParam(parameter);
+    }
+    return 0;
+}
+
+template <class Model>
+Model &CurveFitter<Model>::getModel()
+{
+    return _model;
+}
+
+template <class Model>
+void CurveFitter<Model>::sortPoints(curve_point_t *points, int n)
+{
+    int max = n;
+    while (max > 0) {
+        
+        for (int i = 0; i < max-1; i++) {
+            if (points[i].x > points[i+1].x) {
+                curve_point_t swap = points[i];
+                points[i] = points[i+1];
+                points[i+1] = swap;
+            }
+        }
+
+        max--;
+    }
+}
+
 #endif
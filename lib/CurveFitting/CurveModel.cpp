@@ -0,0 +1,94 @@
+/*
+ * CurveModel.cpp - Points and helpers shared by the CurveFitting models.
+ * Released into the public domain.
+ */
+
+#include "CurveModel.h"
+
+double solveLinear2(double a11, double a12, double a21, double a22, double b1, double b2, double *r1, double *r2) {
+    if (a11 <= 0 || a22 <= 0) {
+        return INFINITY;
+    }
+
+    // unit diagonal: e = d a d, d = diag(1/sqrt(a11), 1/sqrt(a22))
+    double d1 = 1 / sqrt(a11);
+    double d2 = 1 / sqrt(a22);
+    double e12 = a12 * d1 * d2;
+    double e21 = a21 * d1 * d2;
+
+    double det = 1 - (e21 * e12);
+    if (det <= 0) {
+        return INFINITY;
+    }
+    double e11_inv = 1/det;
+    double e12_inv = (-1 * e12)/det;
+    double e21_inv = (-1 * e21)/det;
+    double e22_inv = 1/det;
+
+    *r1 = d1 * (e11_inv * d1 * b1 + e12_inv * d2 * b2);
+    *r2 = d2 * (e21_inv * d1 * b1 + e22_inv * d2 * b2);
+
+    // largest column sums
+    double norm = 1 + (fabs(e21) > fabs(e12) ? fabs(e21) : fabs(e12));
+    double column1 = fabs(e11_inv) + fabs(e21_inv);
+    double column2 = fabs(e12_inv) + fabs(e22_inv);
+    return norm * (column1 > column2 ? column1 : column2);
+}
+
+static double norm1(const double m[3][3]) {
+    double norm = 0;
+    for (uint8_t j=0; j<3; j++) {
+        double column = fabs(m[0][j]) + fabs(m[1][j]) + fabs(m[2][j]);
+        if (column > norm) {
+            norm = column;
+        }
+    }
+    return norm;
+}
+
+double solveLinear3(const double a[3][3], const double b[3], double r[3]) {
+    double d[3];
+    for (uint8_t i=0; i<3; i++) {
+        if (a[i][i] <= 0) {
+            return INFINITY;
+        }
+        d[i] = 1 / sqrt(a[i][i]);
+    }
+
+    double e[3][3];
+    for (uint8_t i=0; i<3; i++) {
+        for (uint8_t j=0; j<3; j++) {
+            e[i][j] = a[i][j] * d[i] * d[j];
+        }
+    }
+
+    // signed cofactors, indices taken mod 3
+    double cof[3][3];
+    for (uint8_t i=0; i<3; i++) {
+        uint8_t i1 = (i + 1) % 3;
+        uint8_t i2 = (i + 2) % 3;
+        for (uint8_t j=0; j<3; j++) {
+            uint8_t j1 = (j + 1) % 3;
+            uint8_t j2 = (j + 2) % 3;
+            cof[i][j] = e[i1][j1] * e[i2][j2] - e[i1][j2] * e[i2][j1];
+        }
+    }
+
+    double det = e[0][0] * cof[0][0] + e[0][1] * cof[0][1] + e[0][2] * cof[0][2];
+    if (det <= 0) {
+        return INFINITY;
+    }
+
+    double inv[3][3];
+    for (uint8_t i=0; i<3; i++) {
+        for (uint8_t j=0; j<3; j++) {
+            inv[i][j] = cof[j][i] / det;
+        }
+    }
+
+    for (uint8_t i=0; i<3; i++) {
+        r[i] = d[i] * (inv[i][0] * d[0] * b[0] + inv[i][1] * d[1] * b[1] + inv[i][2] * d[2] * b[2]);
+    }
+
+    return norm1(e) * norm1(inv);
+}
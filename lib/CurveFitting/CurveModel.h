@@ -0,0 +1,68 @@
+/*
+ * CurveModel.h - Points and helpers shared by the CurveFitting models.
+ * Released into the public domain.
+ *
+ * A model is a class that CurveFitter<Model> is instantiated with. It
+ * provides:
+ *
+ *   static const uint8_t PARAM_COUNT;   parameters it is described by
+ *   static const uint8_t MIN_POINTS;    points needed before fit()
+ *
+ *   void reset();                       forget the accumulated points
+ *   void accumulate(const curve_point_t *points, int k);
+ *                                       points[k] was appended after
+ *                                       points[0..k-1]
+ *   bool fit(const curve_point_t *points, int n);
+ *                                       estimate the parameters from
+ *                                       the n sorted points
+ *   void setRange(double minX, double maxX);
+ *                                       x range estimate() is used on,
+ *                                       from the next fit/setParams
+ *   double estimate(double x);
+ *   double getParam(uint8_t i);
+ *   void setParams(const double *params);
+ *   double getCondition();              of the systems solved by the
+ *                                       last fit(), see solveLinear2()
+ *   uint8_t refine(const curve_point_t *points, int n,
+ *                  unsigned long budgetMicros);
+ *                                       least squares steps from the
+ *                                       fitted parameters, if any
+ *
+ * Each model lives in its own translation unit, so a sketch only links
+ * the one it instantiates.
+ */
+
+#ifndef CurveModel_h
+#define CurveModel_h
+
+#include "Arduino.h"
+
+/*
+ * A point to fit, in whole milliseconds: 4 bytes instead of the 8 two
+ * doubles take.
+ */
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+} curve_point_t;
+
+/*
+ * How well a CurveFitter fits its points, residuals in y units.
+ */
+typedef struct {
+    double rmsResidual;
+    double maxResidual;
+    double condition;
+    uint8_t refineSteps;
+} fit_quality_t;
+
+/*
+ * Solve a r = b for normal equations, i.e. with a positive diagonal.
+ * The system is scaled to a unit diagonal first, which takes the units
+ * out of the condition number returned: the 1-norm one of the scaled
+ * matrix, INFINITY (and r untouched) if it is singular.
+ */
+double solveLinear2(double a11, double a12, double a21, double a22, double b1, double b2, double *r1, double *r2);
+double solveLinear3(const double a[3][3], const double b[3], double r[3]);
+
+#endif
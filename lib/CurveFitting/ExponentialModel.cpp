@@ -0,0 +1,303 @@
+/*
+ * ExponentialModel.cpp - y = a + b e^(cx) for CurveFitter.
+ * Released into the public domain.
+ */
+
+#include "ExponentialModel.h"
+
+ExponentialModel::ExponentialModel()
+{
+    _a = 0;
+    _b = 0;
+    _c = 0;
+    _condition = 0;
+    reset();
+
+    _tableSize = 0;
+    _tableShift = 0;
+    _tableMinX = EXPONENTIAL_MODEL_TABLE_MIN_X;
+    _tableMaxX = EXPONENTIAL_MODEL_TABLE_MAX_X;
+    _tableError = 0;
+}
+
+void ExponentialModel::reset()
+{
+   _sk = 0;
+   _sum1 = 0;
+   _sum2 = 0;
+   _sum3 = 0;
+   _sum4 = 0;
+   _sum5 = 0;
+}
+
+/*
+ * Adds the k-th point to the sums of the integral equation
+ * y - y1 = A1 (x - x1) + c S, where S is the trapezoidal integral of y
+ * from x1.
+ */
+void ExponentialModel::accumulate(const curve_point_t *points, int k)
+{
+   double x1 = points[0].x;
+   double y1 = points[0].y;
+   double xk = points[k].x;
+   double yk = points[k].y;
+
+   if (k > 0) {
+     _sk += 0.5 * (yk + points[k-1].y) * (xk - points[k-1].x);
+   }
+   else {
+     _sk = 0;
+   }
+
+   _sum1 += ((xk - x1) * (xk - x1));
+   _sum2 += (xk - x1) * _sk;
+   _sum3 += _sk * _sk;
+   _sum4 += ((yk - y1) * (xk - x1));
+   _sum5 += ((yk - y1) * _sk);
+}
+
+bool ExponentialModel::fit(const curve_point_t *points, int n)
+{
+   double rA1;
+   double rB1;
+   double condition1 = solveLinear2(
+      _sum1, _sum2, _sum2, _sum3, // the first matrix
+      _sum4, _sum5,               // the vector
+      &rA1, &rB1                  // the results go here
+   );
+   if (isinf(condition1)) {
+      return false;
+   }
+
+   // tetha_k = e^(c xk), summed on the fly
+   double c = rB1;
+   double sum_th = 0;
+   double sum_th_th = 0;
+   double sum_yk = 0;
+   double sum_yk_thk = 0;
+   for (int k=0; k<n; k++) {
+     double th = exp(points[k].x * c);
+     sum_th     += th;
+     sum_th_th  += th * th;
+     sum_yk     += points[k].y;
+     sum_yk_thk += points[k].y * th;
+   }
+
+   double a;
+   double b;
+   double condition2 = solveLinear2(
+     n, sum_th, sum_th, sum_th_th,
+     sum_yk, sum_yk_thk,
+     &a, &b
+   );
+   if (isinf(condition2)) {
+      return false;
+   }
+
+   _a = a;
+   _b = b;
+   _c = c;
+   _condition = condition1 > condition2 ? condition1 : condition2;
+
+   buildTable();
+   return true;
+}
+
+void ExponentialModel::setRange(double minX, double maxX)
+{
+    _tableMinX = constrain(minX, 0, 65535);
+    _tableMaxX = constrain(maxX, 0, 65535);
+}
+
+double ExponentialModel::estimate(double x)
+{
+    uint32_t span = (uint32_t) (_tableSize - 1) << _tableShift;
+    if (_tableSize > 0 && x >= _tableMinX && x < _tableMinX + span) {
+        uint32_t dx = (uint32_t) (x - _tableMinX + 0.5);
+        uint8_t i = dx >> _tableShift;
+        if (i == _tableSize - 1) {
+            return _table[i];
+        }
+
+        // y0 + (y1 - y0) * frac / step, rounded
+        int32_t frac = dx & (((uint32_t) 1 << _tableShift) - 1);
+        int32_t y0 = _table[i];
+        int32_t dy = (int32_t) _table[i+1] - y0;
+        int32_t half = _tableShift > 0 ? (int32_t) 1 << (_tableShift - 1) : 0;
+        return y0 + ((dy * frac + half) >> _tableShift);
+    }
+
+    return estimateExact(x);
+}
+
+double ExponentialModel::estimateExact(double x)
+{
+    return _a + ( _b * exp(_c * x) );
+}
+
+double ExponentialModel::getParam(uint8_t i)
+{
+    if (i == 0) {
+        return _a;
+    }
+    else if (i == 1) {
+        return _b;
+    }
+    else if (i == 2) {
+        return _c;
+    }
+    return 0;
+}
+
+void ExponentialModel::setParams(const double *params)
+{
+    _a = params[0];
+    _b = params[1];
+    _c = params[2];
+
+    buildTable();
+}
+
+double ExponentialModel::getCondition()
+{
+    return _condition;
+}
+
+/*
+ * Each pass works out the squared error at the current parameters and
+ * the normal equations of the step from there: r = y - a - b e^(cx),
+ * J = (1, e^(cx), b x e^(cx)). A step that made the error worse is
+ * retried at half the length, which the first full step from the
+ * closed-form parameters often needs. Returns the steps kept.
+ */
+uint8_t ExponentialModel::refine(const curve_point_t *points, int n, unsigned long budgetMicros)
+{
+    unsigned long startMicros = micros();
+
+    double bestA = _a;
+    double bestB = _b;
+    double bestC = _c;
+    double bestError = INFINITY;
+    double delta[3] = { 0, 0, 0 };
+    double length = 1;
+    uint8_t steps = 0;
+
+    for (uint8_t pass=0; pass<EXPONENTIAL_MODEL_REFINE_PASSES; pass++) {
+        double jtj[3][3] = { { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 } };
+        double jtr[3] = { 0, 0, 0 };
+        double error = 0;
+
+        for (int k=0; k<n; k++) {
+            double th = exp(_c * points[k].x);
+            double r = points[k].y - _a - _b * th;
+            double dc = _b * (points[k].x / EXPONENTIAL_MODEL_C_SCALE) * th;
+            double j[3] = { 1, th, dc };
+
+            for (uint8_t p=0; p<3; p++) {
+                for (uint8_t q=0; q<3; q++) {
+                    jtj[p][q] += j[p] * j[q];
+                }
+                jtr[p] += j[p] * r;
+            }
+            error += r * r;
+        }
+
+        if (error < bestError) {
+            if (pass > 0) {
+                steps++;
+            }
+            bestA = _a;
+            bestB = _b;
+            bestC = _c;
+            bestError = error;
+
+            if (micros() - startMicros >= budgetMicros ||
+                isinf(solveLinear3(jtj, jtr, delta))) {
+                break;
+            }
+            length = 1;
+        }
+        else {
+            length /= 2;
+        }
+
+        _a = bestA + length * delta[0];
+        _b = bestB + length * delta[1];
+        _c = bestC + length * delta[2] / EXPONENTIAL_MODEL_C_SCALE;
+    }
+
+    _a = bestA;
+    _b = bestB;
+    _c = bestC;
+
+    if (steps > 0) {
+        buildTable();
+    }
+    return steps;
+}
+
+bool ExponentialModel::isTableUsable()
+{
+    return _tableSize > 0;
+}
+
+double ExponentialModel::getTableError()
+{
+    return _tableError;
+}
+
+/*
+ * Tabulates a + b e^(cx) from _tableMinX in power of two steps, so that
+ * estimate() gets away with shifts and masks, using as few segments as
+ * cover the range. Also works out how far the interpolation can be
+ * from the exact curve: h^2/8 |f''| for the chord, |f'|/2 for rounding
+ * x to the ms, and 1 ms for rounding the entries and the result.
+ */
+void ExponentialModel::buildTable()
+{
+    _tableSize = 0;
+    _tableError = 0;
+
+    if (_tableMaxX <= _tableMinX) {
+        return;
+    }
+
+    uint16_t range = _tableMaxX - _tableMinX;
+    uint8_t shift = 0;
+    while ((((uint32_t) range + ((uint32_t) 1 << shift) - 1) >> shift) >
+           EXPONENTIAL_MODEL_TABLE_SEGMENTS) {
+        shift++;
+    }
+    uint32_t step = (uint32_t) 1 << shift;
+    uint8_t size = ((range + step - 1) >> shift) + 1;
+
+    double error = 0;
+    double prevTh = 0;
+    for (uint8_t i=0; i<size; i++) {
+        double th = exp(_c * (_tableMinX + i * step));
+        double y = _a + _b * th;
+        if (y < 0 || y > 65535) {
+            // out of what the table holds, estimate() stays exact
+            _tableError = -1;
+            return;
+        }
+        _table[i] = (uint16_t) (y + 0.5);
+
+        if (i > 0) {
+            double thMax = th > prevTh ? th : prevTh;
+            double segmentError = ((double) step * step / 8) * fabs(_b * _c * _c) * thMax +
+                0.5 * fabs(_b * _c) * thMax;
+            if (segmentError > error) {
+                error = segmentError;
+            }
+        }
+        prevTh = th;
+    }
+
+    _tableShift = shift;
+    _tableError = error + 1.0;
+
+    if (_tableError <= EXPONENTIAL_MODEL_TABLE_MAX_ERROR) {
+        _tableSize = size;
+    }
+}
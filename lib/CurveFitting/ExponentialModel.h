@@ -0,0 +1,88 @@
+/*
+ * ExponentialModel.h - y = a + b e^(cx) for CurveFitter.
+ * Released into the public domain.
+ */
+
+#ifndef ExponentialModel_h
+#define ExponentialModel_h
+
+#include "CurveModel.h"
+
+// segments of the piecewise-linear table behind estimate()
+#define EXPONENTIAL_MODEL_TABLE_SEGMENTS 16
+
+// x range tabulated by setParams() until a fit says otherwise
+#define EXPONENTIAL_MODEL_TABLE_MIN_X 0
+#define EXPONENTIAL_MODEL_TABLE_MAX_X 4000
+
+// the table is only used if it is this close to a + b e^(cx)
+#define EXPONENTIAL_MODEL_TABLE_MAX_ERROR 2.0
+
+// refine() evaluates the error at most this many times
+#define EXPONENTIAL_MODEL_REFINE_PASSES 8
+
+// c is refined as c * this, for the normal equations to be balanced
+#define EXPONENTIAL_MODEL_C_SCALE 1024.0
+
+/*
+ * Fitted with Jacquelin's integral equation, which gives c from a
+ * linear least squares on the running integral of y, then a and b from
+ * another one with c fixed. The first stage is kept as running sums.
+ *
+ * That minimizes the error in the integral equation rather than in y;
+ * refine() then takes Gauss-Newton steps on the squared error in y,
+ * keeping a step only if it lowers it.
+ */
+class ExponentialModel
+{
+    public:
+        static const uint8_t PARAM_COUNT = 3;
+        static const uint8_t MIN_POINTS = 3;
+
+        ExponentialModel();
+        void reset();
+        void accumulate(const curve_point_t *points, int k);
+        bool fit(const curve_point_t *points, int n);
+        void setRange(double minX, double maxX);
+        double estimate(double x);
+        double getParam(uint8_t i);
+        void setParams(const double *params);
+        double getCondition();
+        uint8_t refine(const curve_point_t *points, int n, unsigned long budgetMicros);
+
+        /*
+         * estimate() interpolates a fixed-point table built whenever
+         * the parameters change, and falls back to estimateExact()
+         * outside the table or when the table would be off by more
+         * than EXPONENTIAL_MODEL_TABLE_MAX_ERROR.
+         */
+        double estimateExact(double x);
+        bool isTableUsable();
+        double getTableError();
+
+    private:
+        void buildTable();
+
+        double _a;
+        double _b;
+        double _c;
+        double _condition;
+
+        // running sums over the points, see accumulate()
+        double _sk;
+        double _sum1;
+        double _sum2;
+        double _sum3;
+        double _sum4;
+        double _sum5;
+
+        // estimate() table: y in ms at x = _tableMinX + (i << _tableShift)
+        uint16_t _table[EXPONENTIAL_MODEL_TABLE_SEGMENTS + 1];
+        uint8_t _tableSize;
+        uint8_t _tableShift;
+        uint16_t _tableMinX;
+        uint16_t _tableMaxX;
+        double _tableError;
+};
+
+#endif
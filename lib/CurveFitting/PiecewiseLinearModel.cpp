@@ -0,0 +1,94 @@
+/*
+ * PiecewiseLinearModel.cpp - Monotone polyline through knots for
+ * CurveFitter.
+ * Released into the public domain.
+ */
+
+#include "PiecewiseLinearModel.h"
+
+PiecewiseLinearModel::PiecewiseLinearModel()
+{
+    for (uint8_t j=0; j<PIECEWISE_LINEAR_MODEL_KNOTS; j++) {
+        _knotX[j] = 0;
+        _knotY[j] = 0;
+    }
+}
+
+void PiecewiseLinearModel::reset()
+{
+    // the knots are worked out from all the points in fit()
+}
+
+void PiecewiseLinearModel::accumulate(const curve_point_t *points, int k)
+{
+}
+
+bool PiecewiseLinearModel::fit(const curve_point_t *points, int n)
+{
+    int begin = 0;
+    for (uint8_t j=0; j<PIECEWISE_LINEAR_MODEL_KNOTS; j++) {
+        // runs as even as n allows, none empty since n >= MIN_POINTS
+        int end = (long) n * (j + 1) / PIECEWISE_LINEAR_MODEL_KNOTS;
+
+        double sumX = 0;
+        double sumY = 0;
+        for (int k=begin; k<end; k++) {
+            sumX += points[k].x;
+            sumY += points[k].y;
+        }
+        _knotX[j] = sumX / (end - begin);
+        _knotY[j] = sumY / (end - begin);
+
+        if (j > 0 && _knotY[j] < _knotY[j-1]) {
+            _knotY[j] = _knotY[j-1];
+        }
+        begin = end;
+    }
+    return true;
+}
+
+double PiecewiseLinearModel::getCondition()
+{
+    // means, nothing is solved
+    return 1;
+}
+
+uint8_t PiecewiseLinearModel::refine(const curve_point_t *points, int n, unsigned long budgetMicros)
+{
+    return 0;
+}
+
+void PiecewiseLinearModel::setRange(double minX, double maxX)
+{
+    // the knots already cover the points
+}
+
+double PiecewiseLinearModel::estimate(double x)
+{
+    uint8_t j = 0;
+    while (j < PIECEWISE_LINEAR_MODEL_KNOTS - 2 && x >= _knotX[j+1]) {
+        j++;
+    }
+
+    double dx = _knotX[j+1] - _knotX[j];
+    if (dx <= 0) {
+        return _knotY[j];
+    }
+    return _knotY[j] + (x - _knotX[j]) * (_knotY[j+1] - _knotY[j]) / dx;
+}
+
+double PiecewiseLinearModel::getParam(uint8_t i)
+{
+    if (i < PARAM_COUNT) {
+        return i % 2 == 0 ? _knotX[i / 2] : _knotY[i / 2];
+    }
+    return 0;
+}
+
+void PiecewiseLinearModel::setParams(const double *params)
+{
+    for (uint8_t j=0; j<PIECEWISE_LINEAR_MODEL_KNOTS; j++) {
+        _knotX[j] = params[2 * j];
+        _knotY[j] = params[2 * j + 1];
+    }
+}
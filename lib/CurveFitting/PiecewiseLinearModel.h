@@ -0,0 +1,41 @@
+/*
+ * PiecewiseLinearModel.h - Monotone polyline through knots for
+ * CurveFitter.
+ * Released into the public domain.
+ */
+
+#ifndef PiecewiseLinearModel_h
+#define PiecewiseLinearModel_h
+
+#include "CurveModel.h"
+
+#define PIECEWISE_LINEAR_MODEL_KNOTS 4
+
+/*
+ * The points are split into one run per knot, each knot being the mean
+ * of its run, and knot y never decreases. Outside the knots the end
+ * segments are extended. The parameters are x0, y0, x1, y1, ...
+ */
+class PiecewiseLinearModel
+{
+    public:
+        static const uint8_t PARAM_COUNT = 2 * PIECEWISE_LINEAR_MODEL_KNOTS;
+        static const uint8_t MIN_POINTS = PIECEWISE_LINEAR_MODEL_KNOTS;
+
+        PiecewiseLinearModel();
+        void reset();
+        void accumulate(const curve_point_t *points, int k);
+        bool fit(const curve_point_t *points, int n);
+        void setRange(double minX, double maxX);
+        double estimate(double x);
+        double getParam(uint8_t i);
+        void setParams(const double *params);
+        double getCondition();
+        uint8_t refine(const curve_point_t *points, int n, unsigned long budgetMicros);
+
+    private:
+        double _knotX[PIECEWISE_LINEAR_MODEL_KNOTS];
+        double _knotY[PIECEWISE_LINEAR_MODEL_KNOTS];
+};
+
+#endif
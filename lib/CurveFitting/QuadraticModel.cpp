@@ -0,0 +1,114 @@
+/*
+ * QuadraticModel.cpp - y = a + b u + c u^2 for CurveFitter.
+ * Released into the public domain.
+ */
+
+#include "QuadraticModel.h"
+
+QuadraticModel::QuadraticModel()
+{
+    _a = 0;
+    _b = 0;
+    _c = 0;
+    _x0 = 0;
+    _condition = 0;
+    reset();
+}
+
+void QuadraticModel::reset()
+{
+    _origin = 0;
+    for (uint8_t i=0; i<5; i++) {
+        _sumU[i] = 0;
+    }
+    for (uint8_t i=0; i<3; i++) {
+        _sumUY[i] = 0;
+    }
+}
+
+void QuadraticModel::accumulate(const curve_point_t *points, int k)
+{
+    if (k == 0) {
+        _origin = points[0].x;
+    }
+
+    double u = (points[k].x - _origin) / QUADRATIC_MODEL_X_SCALE;
+    double y = points[k].y;
+
+    double ui = 1;
+    for (uint8_t i=0; i<5; i++) {
+        _sumU[i] += ui;
+        if (i < 3) {
+            _sumUY[i] += ui * y;
+        }
+        ui *= u;
+    }
+}
+
+bool QuadraticModel::fit(const curve_point_t *points, int n)
+{
+    const double a[3][3] = {
+        { _sumU[0], _sumU[1], _sumU[2] },
+        { _sumU[1], _sumU[2], _sumU[3] },
+        { _sumU[2], _sumU[3], _sumU[4] }
+    };
+    double r[3];
+    double condition = solveLinear3(a, _sumUY, r);
+    if (isinf(condition)) {
+        return false;
+    }
+
+    _a = r[0];
+    _b = r[1];
+    _c = r[2];
+    _x0 = _origin;
+    _condition = condition;
+    return true;
+}
+
+double QuadraticModel::getCondition()
+{
+    return _condition;
+}
+
+uint8_t QuadraticModel::refine(const curve_point_t *points, int n, unsigned long budgetMicros)
+{
+    // fit() already is the least squares solution in y
+    return 0;
+}
+
+void QuadraticModel::setRange(double minX, double maxX)
+{
+    // nothing to tabulate, two multiplications are cheap enough
+}
+
+double QuadraticModel::estimate(double x)
+{
+    double u = (x - _x0) / QUADRATIC_MODEL_X_SCALE;
+    return _a + u * (_b + u * _c);
+}
+
+double QuadraticModel::getParam(uint8_t i)
+{
+    if (i == 0) {
+        return _a;
+    }
+    else if (i == 1) {
+        return _b;
+    }
+    else if (i == 2) {
+        return _c;
+    }
+    else if (i == 3) {
+        return _x0;
+    }
+    return 0;
+}
+
+void QuadraticModel::setParams(const double *params)
+{
+    _a = params[0];
+    _b = params[1];
+    _c = params[2];
+    _x0 = params[3];
+}
@@ -0,0 +1,49 @@
+/*
+ * QuadraticModel.h - y = a + b u + c u^2 for CurveFitter.
+ * Released into the public domain.
+ */
+
+#ifndef QuadraticModel_h
+#define QuadraticModel_h
+
+#include "CurveModel.h"
+
+// u = (x - x0) / QUADRATIC_MODEL_X_SCALE keeps u^4 within float range
+#define QUADRATIC_MODEL_X_SCALE 1024.0
+
+/*
+ * Least squares parabola in u, measured from the first point so the
+ * normal equations stay well conditioned in single precision. The
+ * parameters are a, b, c and x0.
+ */
+class QuadraticModel
+{
+    public:
+        static const uint8_t PARAM_COUNT = 4;
+        static const uint8_t MIN_POINTS = 3;
+
+        QuadraticModel();
+        void reset();
+        void accumulate(const curve_point_t *points, int k);
+        bool fit(const curve_point_t *points, int n);
+        void setRange(double minX, double maxX);
+        double estimate(double x);
+        double getParam(uint8_t i);
+        void setParams(const double *params);
+        double getCondition();
+        uint8_t refine(const curve_point_t *points, int n, unsigned long budgetMicros);
+
+    private:
+        double _a;
+        double _b;
+        double _c;
+        double _x0;
+        double _condition;
+
+        // sums of u^i and u^i y over the points, see accumulate()
+        double _origin;
+        double _sumU[5];
+        double _sumUY[3];
+};
+
+#endif
@@ -0,0 +1,67 @@
+/*
+ * EstimateBenchmark.ino - Times ExponentialModel::estimate() against
+ * estimateExact() and reports how far apart they get, over Serial.
+ * Released into the public domain.
+ *
+ * Set the parameters below to the ones shown on the A/B/C screens.
+ */
+
+#include <CurveFitting.h>
+
+#define PARAM_A -473.90
+#define PARAM_B 1719.35
+#define PARAM_C 0.0001
+#define MIN_X 600
+#define MAX_X 3000
+#define CALLS 1000
+
+ExponentialModel Fit;
+
+// keeps the compiler from dropping the calls being timed
+volatile double sink;
+
+unsigned long timeCalls(bool exact)
+{
+    unsigned long start = micros();
+    for (int i=0; i<CALLS; i++) {
+        double x = MIN_X + (i % (MAX_X - MIN_X));
+        sink = exact ? Fit.estimateExact(x) : Fit.estimate(x);
+    }
+    return micros() - start;
+}
+
+void setup()
+{
+    Serial.begin(9600);
+
+    const double params[] = { PARAM_A, PARAM_B, PARAM_C };
+    Fit.setRange(MIN_X, MAX_X);
+    Fit.setParams(params);
+
+    double worst = 0;
+    for (int x=MIN_X; x<MAX_X; x++) {
+        double error = fabs(Fit.estimate(x) - Fit.estimateExact(x));
+        if (error > worst) {
+            worst = error;
+        }
+    }
+
+    // the loop overhead is the same in both, so the difference is fair
+    unsigned long tableMicros = timeCalls(false);
+    unsigned long exactMicros = timeCalls(true);
+
+    Serial.print("table usable: ");
+    Serial.println(Fit.isTableUsable() ? "yes" : "no");
+    Serial.print("error bound (ms): ");
+    Serial.println(Fit.getTableError());
+    Serial.print("worst error (ms): ");
+    Serial.println(worst);
+    Serial.print("estimate() cycles/call: ");
+    Serial.println(tableMicros * (F_CPU / 1000000L) / CALLS);
+    Serial.print("estimateExact() cycles/call: ");
+    Serial.println(exactMicros * (F_CPU / 1000000L) / CALLS);
+}
+
+void loop()
+{
+}
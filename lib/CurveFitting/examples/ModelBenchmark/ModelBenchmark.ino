@@ -0,0 +1,59 @@
+/*
+ * ModelBenchmark.ino - Reports what a CurveFitter model costs: RAM,
+ * time to fit, time to estimate. Flash is what avr-size says about this
+ * sketch built with one MODEL against another.
+ * Released into the public domain.
+ */
+
+#include <CurveFitting.h>
+
+// ExponentialModel, QuadraticModel or PiecewiseLinearModel
+#define MODEL ExponentialModel
+
+#define POINTS 16
+#define CALLS 1000
+
+curve_point_t points[POINTS];
+CurveFitter<MODEL> Fit;
+
+// keeps the compiler from dropping the calls being timed
+volatile double sink;
+
+void setup()
+{
+    Serial.begin(9600);
+
+    // a calibration like the ones the sketch records
+    unsigned long fitMicros = 0;
+    Fit.beginFit(points, POINTS);
+    for (int i=0; i<POINTS; i++) {
+        double x = 600 + i * 150;
+        double y = 500 + 1200 * exp(0.0004 * x);
+
+        unsigned long start = micros();
+        Fit.addPoint(x, y);
+        fitMicros += micros() - start;
+    }
+
+    unsigned long start = micros();
+    for (int i=0; i<CALLS; i++) {
+        sink = Fit.estimate(600 + (i % 2400));
+    }
+    unsigned long estimateMicros = micros() - start;
+
+    Serial.print("RAM (bytes): ");
+    Serial.println(sizeof(Fit));
+    Serial.print("addPoint() us/point: ");
+    Serial.println(fitMicros / POINTS);
+    Serial.print("estimate() cycles/call: ");
+    Serial.println(estimateMicros * (F_CPU / 1000000L) / CALLS);
+    for (int i=0; i<Fit.getParamCount(); i++) {
+        Serial.print((char) ('A' + i));
+        Serial.print(' ');
+        Serial.println(Fit.getEstimatedParameter(i), 6);
+    }
+}
+
+void loop()
+{
+}
@@ -0,0 +1,236 @@
+/*
+ * HistoryLog.cpp - Library for a compact, append-only log in EEPROM.
+ * Released into the public domain.
+ */
+
+#include "HistoryLog.h"
+#include <avr/eeprom.h>
+
+HistoryLog::HistoryLog(uint16_t start, uint8_t blockCount, uint8_t blockSize, uint8_t version)
+{
+    _start = start;
+    _blockCount = blockCount;
+    _blockSize = blockSize;
+    _version = version;
+    _block = 0;
+    _sequence = HISTORY_LOG_BLANK;
+    _count = 0;
+    _offset = HISTORY_LOG_BLOCK_HEADER;
+    _entries = 0;
+    _writeCount = 0;
+    _written = 0;
+}
+
+/*
+ * Walks the newest block to the end, for the values the next entry is
+ * stored against.
+ */
+void HistoryLog::begin()
+{
+    _sequence = HISTORY_LOG_BLANK;
+    _entries = 0;
+
+    for (uint8_t block = 0; block < _blockCount; block++) {
+        uint16_t sequence = readSequence(block);
+        if (sequence == HISTORY_LOG_BLANK) {
+            continue;
+        }
+        _entries += readCount(block);
+
+        // sequence numbers wrap, newer is less than half the range ahead
+        if (_sequence == HISTORY_LOG_BLANK ||
+            (int16_t) (sequence - _sequence) > 0) {
+            _block = block;
+            _sequence = sequence;
+        }
+    }
+
+    memset(_previous, 0, sizeof(_previous));
+    _count = 0;
+    _offset = HISTORY_LOG_BLOCK_HEADER;
+    if (_sequence == HISTORY_LOG_BLANK) {
+        _block = _blockCount - 1;
+        return;
+    }
+
+    history_cursor_t cursor;
+    cursor.block = (_block + _blockCount - 1) % _blockCount;
+    cursor.blocksLeft = 1;
+    cursor.entriesLeft = 0;
+
+    int16_t fields[HISTORY_LOG_FIELDS];
+    while (read(&cursor, fields)) {
+        _count++;
+    }
+    _offset = cursor.offset;
+    memcpy(_previous, cursor.previous, sizeof(_previous));
+}
+
+void HistoryLog::append(const int16_t *fields)
+{
+    uint8_t entry[HISTORY_LOG_FIELDS * 3];
+    uint8_t length;
+
+    // pours are minutes apart, this hardly ever waits
+    while (writeSome()) {
+        eeprom_busy_wait();
+    }
+    _writeCount = 0;
+    _written = 0;
+
+    for (uint8_t attempt = 0; attempt < 2; attempt++) {
+        length = 0;
+        for (uint8_t i = 0; i < HISTORY_LOG_FIELDS; i++) {
+            int16_t delta = fields[i] - _previous[i];
+            uint16_t value = ((uint16_t) delta << 1) ^ (delta < 0 ? 0xFFFF : 0);
+            while (value >= 0x80) {
+                entry[length++] = (value & 0x7F) | 0x80;
+                value >>= 7;
+            }
+            entry[length++] = value;
+        }
+
+        if (_sequence != HISTORY_LOG_BLANK && _count < 0xFF &&
+            _offset + length <= _blockSize) {
+            break;
+        }
+
+        // the block is full, the first entry of the next is stored whole
+        _block = (_block + 1) % _blockCount;
+        _sequence = _sequence + 1 == HISTORY_LOG_BLANK ? 0 : _sequence + 1;
+        startBlock(_sequence);
+        _count = 0;
+        _offset = HISTORY_LOG_BLOCK_HEADER;
+        memset(_previous, 0, sizeof(_previous));
+    }
+
+    for (uint8_t i = 0; i < length; i++) {
+        queueWrite(_offset + i, entry[i]);
+    }
+    queueWrite(3, ++_count);
+
+    _offset += length;
+    memcpy(_previous, fields, sizeof(_previous));
+    _entries++;
+}
+
+bool HistoryLog::isWriting()
+{
+    return _written < _writeCount;
+}
+
+bool HistoryLog::writeSome()
+{
+    // bytes that are already right take no time, the others one at a time
+    while (isWriting() && eeprom_is_ready()) {
+        eeprom_update_byte(blockAddress(_block) + _writes[_written][0], _writes[_written][1]);
+        _written++;
+    }
+
+    return isWriting();
+}
+
+uint16_t HistoryLog::getCount()
+{
+    return _entries;
+}
+
+/*
+ * Blocks are written in turn, so the oldest is the one after the
+ * newest, or the first one while the log has not gone round yet.
+ */
+void HistoryLog::rewind(history_cursor_t *cursor)
+{
+    cursor->block = _block;
+    cursor->blocksLeft = _sequence == HISTORY_LOG_BLANK ? 0 : _blockCount;
+    cursor->entriesLeft = 0;
+}
+
+bool HistoryLog::read(history_cursor_t *cursor, int16_t *fields)
+{
+    for (;;) {
+        while (cursor->entriesLeft == 0) {
+            if (cursor->blocksLeft == 0) {
+                return false;
+            }
+            cursor->block = (cursor->block + 1) % _blockCount;
+            cursor->blocksLeft--;
+
+            if (readSequence(cursor->block) != HISTORY_LOG_BLANK) {
+                cursor->entriesLeft = readCount(cursor->block);
+                cursor->offset = HISTORY_LOG_BLOCK_HEADER;
+                memset(cursor->previous, 0, sizeof(cursor->previous));
+            }
+        }
+
+        if (readEntry(cursor, fields)) {
+            cursor->entriesLeft--;
+            return true;
+        }
+
+        // a count that does not match the block, skip the rest of it
+        cursor->entriesLeft = 0;
+    }
+}
+
+bool HistoryLog::readEntry(history_cursor_t *cursor, int16_t *fields)
+{
+    uint8_t *p = blockAddress(cursor->block);
+
+    for (uint8_t i = 0; i < HISTORY_LOG_FIELDS; i++) {
+        uint16_t value = 0;
+        uint8_t shift = 0;
+        uint8_t b;
+        do {
+            if (cursor->offset >= _blockSize) {
+                return false;
+            }
+            b = eeprom_read_byte(p + cursor->offset++);
+            value |= (uint16_t) (b & 0x7F) << shift;
+            shift += 7;
+        } while (b & 0x80);
+
+        cursor->previous[i] += (int16_t) ((value >> 1) ^ -(value & 1));
+        fields[i] = cursor->previous[i];
+    }
+    return true;
+}
+
+uint8_t *HistoryLog::blockAddress(uint8_t block)
+{
+    return (uint8_t *) (uintptr_t) (_start + block * _blockSize);
+}
+
+uint16_t HistoryLog::readSequence(uint8_t block)
+{
+    uint8_t *p = blockAddress(block);
+    if (eeprom_read_byte(p + 2) != _version) {
+        return HISTORY_LOG_BLANK;
+    }
+    return eeprom_read_byte(p) | eeprom_read_byte(p + 1) << 8;
+}
+
+uint8_t HistoryLog::readCount(uint8_t block)
+{
+    return eeprom_read_byte(blockAddress(block) + 3);
+}
+
+/*
+ * The count is cleared first: torn half way, the block still has its
+ * old sequence number and no entries.
+ */
+void HistoryLog::startBlock(uint16_t sequence)
+{
+    _entries -= readSequence(_block) == HISTORY_LOG_BLANK ? 0 : readCount(_block);
+    queueWrite(3, 0);
+    queueWrite(2, _version);
+    queueWrite(0, sequence & 0xFF);
+    queueWrite(1, sequence >> 8);
+}
+
+void HistoryLog::queueWrite(uint8_t offset, uint8_t value)
+{
+    _writes[_writeCount][0] = offset;
+    _writes[_writeCount][1] = value;
+    _writeCount++;
+}
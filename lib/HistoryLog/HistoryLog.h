@@ -0,0 +1,109 @@
+/*
+ * HistoryLog.h - Library for a compact, append-only log in EEPROM.
+ * Released into the public domain.
+ */
+
+#ifndef HistoryLog_h
+#define HistoryLog_h
+
+#include "Arduino.h"
+
+// values in each entry
+#ifndef HISTORY_LOG_FIELDS
+#define HISTORY_LOG_FIELDS 4
+#endif
+
+// sequence, version and entry count
+#define HISTORY_LOG_BLOCK_HEADER 4
+
+// a block that was never written
+#define HISTORY_LOG_BLANK 0xFFFF
+
+// EEPROM bytes an append may write: a new block's header, the entry
+// and the count
+#define HISTORY_LOG_MAX_WRITES (HISTORY_LOG_BLOCK_HEADER + HISTORY_LOG_FIELDS * 3 + 1)
+
+/*
+ * Where a reader is, see rewind() and read(). Readers are independent
+ * of each other and of append(), save that an append can overwrite the
+ * block a reader has not got to yet.
+ */
+typedef struct {
+    // the block being read, and how many more to go
+    uint8_t block;
+    uint8_t blocksLeft;
+    uint8_t offset;
+    uint8_t entriesLeft;
+    int16_t previous[HISTORY_LOG_FIELDS];
+} history_cursor_t;
+
+/*
+ * A region of EEPROM split in blockCount blocks of blockSize bytes,
+ * written one after the other and around again, so that the oldest
+ * block goes to make room. An entry is HISTORY_LOG_FIELDS values, each
+ * stored as the difference from the entry before it in the block, as a
+ * zig-zag varint: values that change slowly take a byte each.
+ *
+ * A block starts with its sequence number, the version it was written
+ * with and how many entries it has; a block of another version, such
+ * as whatever was in EEPROM before, counts as never written.
+ * The entry is written before the count goes up, so a reset mid-write
+ * loses that entry at most. The first entry of a block is stored whole,
+ * so losing the oldest block loses nothing else. A block has to hold
+ * at least one entry whole: HISTORY_LOG_BLOCK_HEADER plus three bytes
+ * a field.
+ *
+ * append() only queues the bytes; writeSome() writes them while the
+ * EEPROM is ready, in the same order: call it every loop() until it
+ * returns false. An append before then finishes the one before first.
+ */
+class HistoryLog
+{
+    public:
+        HistoryLog(uint16_t start, uint8_t blockCount, uint8_t blockSize, uint8_t version);
+
+        // finds the newest block and where the next entry goes
+        void begin();
+
+        void append(const int16_t *fields);
+        bool isWriting();
+
+        // never waits for the EEPROM; false once the append is written
+        bool writeSome();
+
+        // entries in the log
+        uint16_t getCount();
+
+        // oldest entry first
+        void rewind(history_cursor_t *cursor);
+        bool read(history_cursor_t *cursor, int16_t *fields);
+
+    private:
+        bool readEntry(history_cursor_t *cursor, int16_t *fields);
+        uint8_t *blockAddress(uint8_t block);
+        uint16_t readSequence(uint8_t block);
+        uint8_t readCount(uint8_t block);
+        void startBlock(uint16_t sequence);
+        void queueWrite(uint8_t offset, uint8_t value);
+
+        uint16_t _start;
+        uint8_t _blockCount;
+        uint8_t _blockSize;
+        uint8_t _version;
+
+        // where the next entry goes, and what it is stored against
+        uint8_t _block;
+        uint16_t _sequence;
+        uint8_t _count;
+        uint8_t _offset;
+        int16_t _previous[HISTORY_LOG_FIELDS];
+
+        uint16_t _entries;
+
+        // offset in _block and value of each byte the append writes
+        uint8_t _writes[HISTORY_LOG_MAX_WRITES][2];
+        uint8_t _writeCount;
+        uint8_t _written;
+};
+
+#endif
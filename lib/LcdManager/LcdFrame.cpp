@@ -0,0 +1,89 @@
+/*
+ * LcdFrame.cpp - Shadow copy of a 16x2 character display.
+ * Released into the public domain.
+ */
+
+#include "LcdFrame.h"
+#include "Arduino.h"
+
+LcdFrame::LcdFrame()
+{
+    // LiquidCrystal::begin() leaves the display blank
+    memset(_shown, ' ', sizeof(_shown));
+    _cursorCol = -1;
+    _cursorRow = 0;
+    clear();
+}
+
+void LcdFrame::clear()
+{
+    memset(_next, ' ', sizeof(_next));
+    _col = 0;
+    _row = 0;
+}
+
+void LcdFrame::setCursor(uint8_t col, uint8_t row)
+{
+    _col = col;
+    _row = row;
+}
+
+size_t LcdFrame::write(uint8_t c)
+{
+    // anything past the visible columns is dropped, as on the display
+    if (_row >= LCD_FRAME_ROWS || _col >= LCD_FRAME_COLS) {
+        return 0;
+    }
+
+    _next[_row][_col++] = (char) c;
+    return 1;
+}
+
+void LcdFrame::print_P(PGM_P text)
+{
+    char c;
+    while ((c = pgm_read_byte(text++)) != '\0') {
+        write(c);
+    }
+}
+
+void LcdFrame::invalidate()
+{
+    memset(_shown, 0, sizeof(_shown));
+    _cursorCol = -1;
+}
+
+void LcdFrame::flush(LcdWriteQueue *queue)
+{
+    for (uint8_t row = 0; row < LCD_FRAME_ROWS; row++) {
+        for (uint8_t col = 0; col < LCD_FRAME_COLS; col++) {
+            if (_next[row][col] == _shown[row][col]) {
+                continue;
+            }
+
+            // at worst a cursor move and the character
+            if (queue->getFree() < 2) {
+                return;
+            }
+
+            /*
+             * Moving the cursor costs one command byte: rewriting a single
+             * unchanged character in between costs the same.
+             */
+            bool onRow = _cursorCol >= 0 && _cursorRow == row;
+            if (onRow && _cursorCol == col - 1) {
+                queue->write(_shown[row][_cursorCol]);
+            }
+            else if (!onRow || _cursorCol != col) {
+                queue->setCursor(col, row);
+            }
+
+            queue->write(_next[row][col]);
+            _shown[row][col] = _next[row][col];
+
+            // the controller does not wrap onto the next visible row
+            _cursorCol = col + 1;
+            _cursorRow = row;
+        }
+    }
+}
@@ -0,0 +1,55 @@
+/*
+ * LcdFrame.h - Shadow copy of a 16x2 character display.
+ * Released into the public domain.
+ */
+
+#ifndef LcdFrame_h
+#define LcdFrame_h
+
+#include "Arduino.h"
+#include "LcdWriteQueue.h"
+
+#define LCD_FRAME_COLS 16
+#define LCD_FRAME_ROWS 2
+
+/*
+ * A frame is drawn with the usual clear/setCursor/print calls, which only
+ * touch RAM. flush() then compares it with what the display already shows
+ * and queues just the characters that changed, plus a cursor move wherever
+ * a run of changes does not follow on from the last.
+ *
+ * flush() stops when the queue is full; the cells it did not get to are
+ * still different, so the next call picks up where it left off.
+ */
+class LcdFrame : public Print
+{
+    public:
+        LcdFrame();
+
+        // starts a new, blank frame
+        void clear();
+        void setCursor(uint8_t col, uint8_t row);
+        virtual size_t write(uint8_t c);
+        using Print::write;
+
+        // text kept in flash, see PSTR()
+        void print_P(PGM_P text);
+
+        // forgets what the display shows, so the next flush sends everything
+        void invalidate();
+
+        void flush(LcdWriteQueue *queue);
+
+    private:
+        char _next[LCD_FRAME_ROWS][LCD_FRAME_COLS];
+        char _shown[LCD_FRAME_ROWS][LCD_FRAME_COLS];
+        uint8_t _col;
+        uint8_t _row;
+
+        // where the controller's cursor will be once the queue is sent,
+        // _cursorCol is -1 if unknown
+        int8_t _cursorCol;
+        uint8_t _cursorRow;
+};
+
+#endif
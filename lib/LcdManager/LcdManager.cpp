@@ -7,67 +7,129 @@
 #include "LcdManager.h"
 #include "Arduino.h"
 
-LcdManager::LcdManager(LiquidCrystal *lcd, void (*notifyFunc) (message_t, void *param))
+LcdManager::LcdManager(LiquidCrystal *lcd, ButtonScanner *buttons, MessageQueue *messages)
 {
-    _sendMessage = notifyFunc;
+    _messages = messages;
     _lcd = lcd;
+    _buttons = buttons;
+    _currentMode = LCD_MODE_COUNT;
 }
 
+/*
+ * Button events by mode, first match wins. Dispatch is a walk down this
+ * table, so a new screen is a few more rows and its hooks below.
+ */
+const LcdManager::lcd_transition_t LcdManager::_transitions[] PROGMEM = {
+    // buttons 1+2 together: parameter screens, then calibration
+    { LCD_MODE_SHOW_PARAM,  3,                             LCD_MODE_CALIBRATION, &LcdManager::startCalibration },
+    { LCD_MODE_ANY,         3,                             LCD_MODE_SHOW_PARAM,  &LcdManager::showFirstParam },
+
+    { LCD_MODE_SHOW_PARAM,  BUTTON_BIT_1,                  LCD_MODE_SAME,        &LcdManager::leaveParams },
+    { LCD_MODE_SHOW_PARAM,  BUTTON_BIT_2,                  LCD_MODE_HISTORY,     &LcdManager::showNewestHistory },
+    { LCD_MODE_SHOW_PARAM,  BUTTON_BIT_3,                  LCD_MODE_SAME,        &LcdManager::showNextParam },
+
+    { LCD_MODE_HISTORY,     BUTTON_BIT_1,                  LCD_MODE_SAME,        &LcdManager::leaveParams },
+    { LCD_MODE_HISTORY,     BUTTON_BIT_3,                  LCD_MODE_SAME,        &LcdManager::showOlderHistory },
+
+    { LCD_MODE_CALIBRATED,  LCD_EVENT_PRESS | BUTTON_BIT_3, LCD_MODE_SAME,       &LcdManager::strawDown },
+    { LCD_MODE_CALIBRATED,  BUTTON_BIT_1,                  LCD_MODE_SET_UNITS,   NULL },
+    { LCD_MODE_CALIBRATED,  BUTTON_BIT_2,                  LCD_MODE_SAME,        &LcdManager::pourOneUnit },
+    { LCD_MODE_CALIBRATED,  BUTTON_BIT_3,                  LCD_MODE_SAME,        &LcdManager::strawUp },
+
+    { LCD_MODE_CALIBRATION, LCD_EVENT_PRESS | BUTTON_BIT_3, LCD_MODE_SAME,       &LcdManager::strawDown },
+    { LCD_MODE_CALIBRATION, BUTTON_BIT_1,                  LCD_MODE_CALIBRATED,  NULL },
+    { LCD_MODE_CALIBRATION, BUTTON_BIT_2,                  LCD_MODE_CALIBRATED,  &LcdManager::endCalibration },
+    { LCD_MODE_CALIBRATION, BUTTON_BIT_3,                  LCD_MODE_SAME,        &LcdManager::storeCalibrationPoint },
+
+    { LCD_MODE_SET_UNITS,   BUTTON_BIT_1,                  LCD_MODE_SAME,        &LcdManager::decreaseUnits },
+    { LCD_MODE_SET_UNITS,   BUTTON_BIT_2,                  LCD_MODE_SAME,        &LcdManager::increaseUnits },
+    { LCD_MODE_SET_UNITS,   BUTTON_BIT_3,                  LCD_MODE_SET_STARTAT, NULL },
+
+    { LCD_MODE_SET_STARTAT, BUTTON_BIT_1,                  LCD_MODE_SAME,        &LcdManager::decreaseStartAt },
+    { LCD_MODE_SET_STARTAT, BUTTON_BIT_2,                  LCD_MODE_SAME,        &LcdManager::increaseStartAt },
+    { LCD_MODE_SET_STARTAT, BUTTON_BIT_3,                  LCD_MODE_SET_EVERY,   NULL },
+
+    { LCD_MODE_SET_EVERY,   BUTTON_BIT_1,                  LCD_MODE_SAME,        &LcdManager::decreaseEvery },
+    { LCD_MODE_SET_EVERY,   BUTTON_BIT_2,                  LCD_MODE_SAME,        &LcdManager::increaseEvery },
+    { LCD_MODE_SET_EVERY,   BUTTON_BIT_3,                  LCD_MODE_AUTOMATIC,   &LcdManager::recordSchedule },
+
+    { LCD_MODE_AUTOMATIC,   BUTTON_BIT_1,                  LCD_MODE_CALIBRATED,  &LcdManager::cancelSchedules },
+    { LCD_MODE_AUTOMATIC,   BUTTON_BIT_3,                  LCD_MODE_SET_UNITS,   &LcdManager::addSchedule }
+};
+
+// enter, render, loop; in lcd_mode_t order
+const LcdManager::lcd_mode_hooks_t LcdManager::_modeHooks[LCD_MODE_COUNT] PROGMEM = {
+    { &LcdManager::enterModeCalibration, &LcdManager::drawModeCalibration, NULL },
+    { NULL,                              &LcdManager::drawModeMessage,     &LcdManager::loopModeMessage },
+    { NULL,                              NULL,                             NULL }, // LCD_MODE_FILL_WATER
+    { &LcdManager::enterModeCalibrated,  &LcdManager::drawModeCalibrated,  NULL },
+    { NULL,                              &LcdManager::drawModeSetUnits,    NULL },
+    { NULL,                              &LcdManager::drawModeSetStartAt,  NULL },
+    { NULL,                              &LcdManager::drawModeSetEvery,    NULL },
+    { NULL,                              &LcdManager::drawModeAutomatic,   &LcdManager::loopModeAutomatic },
+    { NULL,                              &LcdManager::drawModeShowParam,   NULL },
+    { NULL,                              &LcdManager::drawModeHistory,     NULL }
+};
+
 void LcdManager::begin() {
-    resetBitsStatus();
     _lcd->begin(16, 2);
 
     // sets the default parameters of the LcdState
     setDefaultState();
+    loadSettings();
     setDefaultMode();
+
+    // after a reset in automatic mode, carry on with the schedule
+    if (_currentMode == LCD_MODE_CALIBRATED) {
+        resumeSchedule();
+    }
 }
 
-void LcdManager::drawModeCalibration(int progress, bool showEnd)
+void LcdManager::drawModeCalibration()
 {
-    char *str = "                ";
-
-    sprintf(str, "Fill unit: #%d", progress);
+    char line[LCD_TEXT_SIZE];
+    LcdText(line).label(PSTR("Fill unit: #")).number(this->_modeState.calibration_currentStep);
 
-    _lcd->setCursor(0, 0);
-    _lcd->print(str);
-    _lcd->setCursor(0, 1);
-    _lcd->print( showEnd ? "Cancel End  Pour" : "Cancel      Pour");
+    _frame.setCursor(0, 0);
+    _frame.print(line);
+    _frame.setCursor(0, 1);
+    _frame.print_P(this->_modeState.calibration_showEnd ? PSTR("Cancel End  Pour") : PSTR("Cancel      Pour"));
 }
 
 void LcdManager::drawModeCalibrated()
 {
-    _lcd->clear();
-    _lcd->setCursor(0, 0);
-    _lcd->print("Calibrated");
-    _lcd->setCursor(0, 1);
-    _lcd->print("Record Unit Pour");
+    _frame.setCursor(0, 0);
+    _frame.print_P(PSTR("Calibrated"));
+    _frame.setCursor(0, 1);
+    _frame.print_P(PSTR("Record Unit Pour"));
 }
 
-void LcdManager::drawModeSetUnits(int displayUnits) 
+void LcdManager::drawModeSetUnits()
 {
-    char *str = "                ";
-    sprintf(str, "Pour %d units", displayUnits);
+    char line[LCD_TEXT_SIZE];
+    LcdText(line).label(PSTR("Pour ")).number(this->_modeState.setUnits_units).label(PSTR(" units"));
 
-    _lcd->clear();
-    _lcd->setCursor(0, 0);
-    _lcd->print(str);
-    _lcd->setCursor(0, 1);
-    _lcd->print("-       +   Next");
+    _frame.setCursor(0, 0);
+    _frame.print(line);
+    _frame.setCursor(0, 1);
+    _frame.print_P(PSTR("-       +   Next"));
 }
 
-void LcdManager::drawStartAtMinutes(int minutes)
+void LcdManager::drawModeSetStartAt()
 {
+    int minutes = this->_modeState.setStartAt_minutes;
+
     // hours
     int hours = (int) ((float) minutes / (float) 60);
     int remainingMinutes = minutes - (60 * hours);
 
-    char *str = "                ";
-    sprintf(str, "Pour in %dH %dM", hours, remainingMinutes);
-    _lcd->clear();
-    _lcd->setCursor(0, 0);
-    _lcd->print(str);
-    _lcd->setCursor(0, 1);
-    _lcd->print("-       +   Next");
+    char line[LCD_TEXT_SIZE];
+    LcdText(line).label(PSTR("Pour in ")).number(hours).label(PSTR("H "))
+        .number(remainingMinutes).label(PSTR("M"));
+    _frame.setCursor(0, 0);
+    _frame.print(line);
+    _frame.setCursor(0, 1);
+    _frame.print_P(PSTR("-       +   Next"));
 }
 
 void LcdManager::decomposeMinutes(int inMinutes, int *outDays, int *outHours, int *outMinutes)
@@ -86,68 +148,196 @@ void LcdManager::decomposeMinutes(int inMinutes, int *outDays, int *outHours, in
     *outMinutes = minutes;
 }
 
-void LcdManager::drawEveryMinutes(int inMinutes)
+void LcdManager::drawModeSetEvery()
 {
     int days, hours, minutes;
-    decomposeMinutes(inMinutes, &days, &hours, &minutes);
+    decomposeMinutes(this->_modeState.setEvery_minutes, &days, &hours, &minutes);
 
-    char *str = "                ";
+    char line[LCD_TEXT_SIZE];
+    LcdText text(line);
     if (hours == 0 && days == 0) {
-        sprintf(str, "Every %d min", minutes);
+        text.label(PSTR("Every ")).number(minutes).label(PSTR(" min"));
     }
     else if (days > 0) {
-        sprintf(str, "Ev %dD %dh %dm", days, hours, minutes);
+        text.label(PSTR("Ev ")).number(days).label(PSTR("D "))
+            .number(hours).label(PSTR("h ")).number(minutes).label(PSTR("m"));
     }
-    else if (days == 0) {
-        sprintf(str, "Every %dh %dm", hours, minutes);
+    else {
+        text.label(PSTR("Every ")).number(hours).label(PSTR("h "))
+            .number(minutes).label(PSTR("m"));
+    }
+
+    _frame.setCursor(0, 0);
+    _frame.print(line);
+    _frame.setCursor(0, 1);
+    _frame.print_P(PSTR("-       +   Done"));
+}
 
+void LcdManager::drawModeMessage() {
+    _frame.setCursor(0, 0);
+    _frame.print_P(this->_modeState.message_text);
+}
+
+/*
+ * Shows msg for durationMillis, then switches to nextMode (see loop()).
+ */
+void LcdManager::showMessage(PGM_P msg, unsigned long durationMillis)
+{
+    showMessage(msg, durationMillis,
+        _currentMode == LCD_MODE_MESSAGE ? this->_modeState.message_nextMode : _currentMode);
+}
+
+void LcdManager::showMessage(PGM_P msg, unsigned long durationMillis, lcd_mode_t nextMode)
+{
+    this->_modeState.message_text = msg;
+    this->_modeState.message_untilMillis = millis() + durationMillis;
+    this->_modeState.message_nextMode = nextMode;
+    setMode(LCD_MODE_MESSAGE);
+}
+
+void LcdManager::drawModeShowParam() {
+#ifdef PROFILING
+    msg_get_param_count_t params;
+    sendMessage(params);
+    if (this->_modeState.showParam_index >= params.count) {
+        drawProfile(this->_modeState.showParam_index - params.count);
+        return;
     }
+#endif
+
+    msg_get_param_t request;
+    request.index = this->_modeState.showParam_index;
+    sendMessage(request);
+
+    _frame.setCursor(0, 0);
+    _frame.print((char) ('A' + request.index));
+    _frame.setCursor(2, 0);
+    _frame.print(request.value);
+    _frame.setCursor(0, 1);
+    _frame.print_P(PSTR("Cancel      Next"));
+}
 
-    _lcd->clear();
-    _lcd->setCursor(0, 0);
-    _lcd->print(str);
-    _lcd->setCursor(0, 1);
-    _lcd->print("-       +   Done");
+#ifdef PROFILING
+/*
+ * What 99% of the times came under, and the longest one:
+ *
+ *   Loop 99%<1ms
+ *   max 155ms   Next
+ */
+void LcdManager::drawProfile(uint8_t slot)
+{
+    char line[LCD_TEXT_SIZE];
+    LcdText text(line);
+    text.label(Profile.getName(slot));
+
+    uint32_t bound = Profiler::getBucketBound(Profile.getP99Bucket(slot));
+    if (bound > 0) {
+        text.label(PSTR(" 99%<"));
+        printMicros(text, bound);
+    }
+    else {
+        text.label(PSTR(" 99%>"));
+        printMicros(text, Profiler::getBucketBound(PROFILE_BUCKETS - 2));
+    }
+    _frame.setCursor(0, 0);
+    _frame.print(line);
+
+    LcdText longest(line);
+    longest.label(PSTR("max "));
+    printMicros(longest, Profile.getMaxMicros(slot));
+    _frame.setCursor(0, 1);
+    _frame.print(line);
+    _frame.setCursor(12, 1);
+    _frame.print_P(PSTR("Next"));
 }
 
-void LcdManager::drawModeMessage(char *msg) {
-    _lcd->clear();
-    _lcd->setCursor(0, 0);
-    _lcd->print(msg);
+void LcdManager::printMicros(LcdText &text, uint32_t micros)
+{
+    if (micros < 1000) {
+        text.number(micros).label(PSTR("us"));
+    }
+    else if (micros < 32767000UL) {
+        text.number(micros / 1000).label(PSTR("ms"));
+    }
+    else {
+        text.number(micros / 1000000UL).label(PSTR("s"));
+    }
 }
+#endif
 
-void LcdManager::drawModeShowParam(char paramName, double paramValue) {
-    _lcd->clear();
-    _lcd->setCursor(0, 0);
-    _lcd->print(paramName);
-    _lcd->setCursor(2, 0);
-    _lcd->print(paramValue);
-    _lcd->setCursor(0, 1);
-    _lcd->print("Cancel      Next");
+/*
+ * A past pour, newest first: how many units, how long after the pour
+ * before, the time the water took to reach the straw and how long the
+ * straw was down. P after power-on, I interrupted, E no water.
+ */
+void LcdManager::drawModeHistory()
+{
+    msg_get_history_entry_t entry;
+    entry.index = this->_modeState.history_index;
+    sendMessage(entry);
+
+    _frame.setCursor(0, 0);
+    if (!entry.found) {
+        _frame.print_P(PSTR("No history"));
+        return;
+    }
+
+    char line[LCD_TEXT_SIZE];
+    LcdText(line).label(PSTR("#")).number(entry.index + 1)
+        .label(PSTR(" ")).number(entry.units)
+        .label(PSTR("u +")).number(entry.minutesBefore).label(PSTR("m"));
+    _frame.print(line);
+
+    _frame.setCursor(LCD_FRAME_COLS - 1, 0);
+    if (entry.empty) {
+        _frame.print('E');
+    }
+    else if (entry.interrupted) {
+        _frame.print('I');
+    }
+    else if (entry.afterPowerOn) {
+        _frame.print('P');
+    }
+
+    LcdText(line).number(entry.timeToStrawMillis).label(PSTR("ms "))
+        .number(entry.downMillis).label(PSTR("ms"));
+    _frame.setCursor(0, 1);
+    _frame.print(line);
 }
 
-void LcdManager::drawModeAutomatic(int units, int remainingMinutes)
+void LcdManager::drawModeAutomatic()
 {
+    // while a batch is poured, the units still to go
+    int units = this->_modeState.automatic_unitsToPour > 0 ?
+        this->_modeState.automatic_unitsToPour :
+        this->_modeState.automatic_units;
+
     int days, hours, minutes;
-    decomposeMinutes(remainingMinutes, &days, &hours, &minutes);
+    decomposeMinutes(this->_modeState.automatic_remainingMinutes, &days, &hours, &minutes);
 
-    char *str = "                ";
+    char line[LCD_TEXT_SIZE];
+    LcdText text(line);
+    text.number(units).label(PSTR("u in "));
 
     if (days > 0) {
-        sprintf(str, "%du in %dd%dh", units, days, hours);
+        text.number(days).label(PSTR("d")).number(hours).label(PSTR("h"));
     }
     else if (hours > 0) {
-        sprintf(str, "%du in %dh%dm", units, hours, minutes);
+        text.number(hours).label(PSTR("h")).number(minutes).label(PSTR("m"));
     }
     else {
-        sprintf(str, "%du in %dmin", units, minutes);
+        text.number(minutes).label(PSTR("min"));
     }
 
-    _lcd->clear();
-    _lcd->setCursor(0, 0);
-    _lcd->print(str);
-    _lcd->setCursor(0, 1);
-    _lcd->print("Cancel          ");
+    _frame.setCursor(0, 0);
+    _frame.print(line);
+    _frame.setCursor(0, 1);
+    if (_schedules.getCount() < SCHEDULE_HEAP_CAPACITY) {
+        _frame.print_P(PSTR("Cancel       Add"));
+    }
+    else {
+        _frame.print_P(PSTR("Cancel"));
+    }
 }
 
 void LcdManager::setDefaultState()
@@ -158,365 +348,448 @@ void LcdManager::setDefaultState()
     this->_modeState.setEvery_minutes = 60;
     this->_modeState.automatic_units = 2;
     this->_modeState.automatic_remainingMinutes = 9999;
+    this->_modeState.automatic_unitsToPour = 0;
+    this->_modeState.setUnits_adding = false;
+    this->_modeState.showParam_index = 0;
     this->_modeState.calibration_showEnd = false;
+    this->_modeState.message_text = PSTR("");
 }
 
-void LcdManager::setDefaultMode()
+/*
+ * The schedule last set up is offered again after a reset.
+ */
+void LcdManager::loadSettings()
 {
-    double paramA, paramB, paramC;
+    msg_settings_load_t load;
+    load.settings.units = this->_modeState.setUnits_units;
+    load.settings.startAtMinutes = this->_modeState.setStartAt_minutes;
+    load.settings.everyMinutes = this->_modeState.setEvery_minutes;
 
-    _sendMessage(MSG_GET_PARAM_A, &paramA);
-    _sendMessage(MSG_GET_PARAM_B, &paramB);
-    _sendMessage(MSG_GET_PARAM_C, &paramC);
+    sendMessage(load);
 
-    if (paramA == 0 && paramB == 0 && paramC == 0) {
-        // load the parameters from the eprom 
-        _sendMessage(MSG_CALIBRATION_LOAD, (void *)NULL);
+    this->_modeState.setUnits_units = load.settings.units;
+    this->_modeState.setStartAt_minutes = load.settings.startAtMinutes;
+    this->_modeState.setEvery_minutes = load.settings.everyMinutes;
+}
+
+/*
+ * Written to EEPROM after the button event that changed them has been
+ * dealt with, a few milliseconds the screen does not have to wait for.
+ */
+void LcdManager::saveSettings()
+{
+    msg_settings_save_t save;
+    save.settings.units = this->_modeState.setUnits_units;
+    save.settings.startAtMinutes = this->_modeState.setStartAt_minutes;
+    save.settings.everyMinutes = this->_modeState.setEvery_minutes;
 
-        _sendMessage(MSG_GET_PARAM_A, &paramA);
-        _sendMessage(MSG_GET_PARAM_B, &paramB);
-        _sendMessage(MSG_GET_PARAM_C, &paramC);
+    if (!_messages->post(save)) {
+        sendMessage(save);
+    }
+}
 
-        if (paramA == 0 && paramB == 0 && paramC == 0) {
-            setMode(LCD_MODE_CALIBRATION);
-        }
-        else {
-            setMode(LCD_MODE_CALIBRATED);
-        }
+/*
+ * Checkpoints automatic mode: when it starts or stops, when a pour of
+ * a batch is started and every AUTOMATIC_CHECKPOINT_MINUTES.
+ */
+void LcdManager::saveSchedule()
+{
+    // unused entries and padding too, or the record never matches the last
+    msg_schedule_save_t save;
+    memset(&save, 0, sizeof(save));
+    schedule_state_t &state = save.state;
+    state.unitsToPour = this->_modeState.automatic_unitsToPour;
+    state.count = _schedules.getCount();
+
+    for (uint8_t i = 0; i < state.count; i++) {
+        const schedule_entry_t *entry = _schedules.get(i);
+        state.schedules[i].units = entry->units;
+        state.schedules[i].everyMinutes = entry->periodMillis / 60000;
+        state.schedules[i].remainingSeconds =
+            (int32_t) (entry->dueMillis - millis()) / 1000;
     }
-    else {
+
+    sendMessage(save);
+    _nextCheckpointMillis = millis() + AUTOMATIC_CHECKPOINT_MINUTES * 60000UL;
+}
+
+/*
+ * There is no clock running through a reset, so the time since the last
+ * checkpoint is unknown: it is taken to be the whole checkpoint period,
+ * which can bring a batch forward by that much but never delays one.
+ * Units of an interrupted batch that had not started yet are poured.
+ */
+void LcdManager::resumeSchedule()
+{
+    msg_schedule_load_t load;
+    schedule_state_t &state = load.state;
+    state.count = 0;
+    sendMessage(load);
+
+    if (state.count == 0) {
+        return;
+    }
+
+    _schedules.clear();
+    for (uint8_t i = 0; i < state.count && i < SCHEDULE_HEAP_CAPACITY; i++) {
+        int32_t remainingMillis = state.schedules[i].remainingSeconds * 1000L -
+            AUTOMATIC_CHECKPOINT_MINUTES * 60000L;
+        _schedules.add(
+            state.schedules[i].units,
+            millis() + (remainingMillis > 0 ? remainingMillis : 0),
+            state.schedules[i].everyMinutes * 60000UL
+        );
+    }
+
+    this->_modeState.automatic_unitsToPour = state.unitsToPour;
+    _timeLastPourDone = millis() - AUTOMATIC_POUR_GAP_MILLIS;
+    _batchPourStarted = false;
+    _nextCheckpointMillis = millis() + AUTOMATIC_CHECKPOINT_MINUTES * 60000UL;
+    updateAutomaticCountdown();
+    setMode(LCD_MODE_AUTOMATIC);
+}
+
+void LcdManager::setDefaultMode()
+{
+    msg_is_calibrated_t calibrated;
+    sendMessage(calibrated);
+    bool isCalibrated = calibrated.calibrated;
+
+    if (false == isCalibrated) {
+        // load the parameters from the eprom 
+        msg_calibration_load_t load;
+        sendMessage(load);
+        isCalibrated = load.loaded;
+    }
+
+    if (isCalibrated) {
         setMode(LCD_MODE_CALIBRATED);
     }
+    else {
+        setMode(LCD_MODE_CALIBRATION);
+    }
 }
+/*
+ * Draws the current screen again, after its state changed.
+ */
 void LcdManager::refreshMode()
 {
-    setMode(_currentMode);
+    lcd_hook_t render;
+    memcpy_P(&render, &_modeHooks[_currentMode].render, sizeof(render));
+
+    // draw the whole screen in RAM, loop() sends what changed
+    _frame.clear();
+    if (render != NULL) {
+        (this->*render)();
+    }
+    else {
+        _frame.print_P(PSTR("UNKNOWN MODE!"));
+    }
 }
+
 void LcdManager::setMode(lcd_mode_t mode)
 {
-    double paramA, paramB, paramC;
-
-    _lcd->clear();
-    switch (mode) {
-        case LCD_MODE_SHOW_PARAM_A:
-            _sendMessage(MSG_GET_PARAM_A, &paramA);
-            drawModeShowParam('A', paramA);
-            break;
-        case LCD_MODE_SHOW_PARAM_B:
-            _sendMessage(MSG_GET_PARAM_B, &paramB);
-            drawModeShowParam('B', paramB);
-            break;
-        case LCD_MODE_SHOW_PARAM_C:
-            _sendMessage(MSG_GET_PARAM_C, &paramC);
-            drawModeShowParam('C', paramC);
-            break;
-            
-        case LCD_MODE_CALIBRATION:
-            if (this->_modeState.calibration_currentStep == 1) {
-                _sendMessage(MSG_CALIBRATION_BEGIN, (void *) NULL);
-            }
-
-            drawModeCalibration(
-                this->_modeState.calibration_currentStep,
-                this->_modeState.calibration_showEnd
-            ); // defaults
-            break;
-
-        case LCD_MODE_MESSAGE:
-            drawModeMessage(this->_modeState.message_text);
-            break;
-
-        case LCD_MODE_CALIBRATED:
-            drawModeCalibrated();
-            break;
-
-        case LCD_MODE_SET_UNITS:
-            drawModeSetUnits(
-                this->_modeState.setUnits_units
-            );
-            break;
-
-        case LCD_MODE_SET_STARTAT:
-            drawStartAtMinutes(
-                this->_modeState.setStartAt_minutes
-            );
-            break;
-
-        case LCD_MODE_SET_EVERY:
-            drawEveryMinutes(
-                this->_modeState.setEvery_minutes
-            );
-            break;
-
-        case LCD_MODE_AUTOMATIC:
-            drawModeAutomatic(
-                this->_modeState.automatic_units, 
-                this->_modeState.automatic_remainingMinutes
-            );
-            break;
-
-        default:
-            _lcd->print("UNKNOWN MODE!");
+    lcd_hook_t enter;
+    memcpy_P(&enter, &_modeHooks[mode].enter, sizeof(enter));
+
+    if (mode != _currentMode && enter != NULL) {
+        (this->*enter)();
     }
 
     /* save the mode */
     _currentMode = mode;
+    refreshMode();
+}
+
+void LcdManager::enterModeCalibration()
+{
+    if (this->_modeState.calibration_currentStep == 1) {
+        msg_calibration_begin_t begin;
+        sendMessage(begin);
+    }
 }
 
-void LcdManager::resetBitsStatus()
+void LcdManager::enterModeCalibrated()
 {
-    _bitButtonStatusBefore = 0x0;
-    _bitButtonStatusAfter = 0x0;
+    // whatever was being set up is dropped
+    this->_modeState.setUnits_adding = false;
 }
 
 /*
- * This function is called continually as long as the button is pressed
+ * Handles one event queued by the ButtonScanner: finds what it does in
+ * the current mode in _transitions.
  */
-void LcdManager::onButtonPressed(int button) 
+void LcdManager::onButtonEvent(const button_event_t &event)
 {
-    if (_previousButtonStatus[button-1] == HIGH) {
+    uint8_t buttons;
+    switch (event.type) {
+        case BUTTON_EVENT_PRESS: buttons = event.buttons | LCD_EVENT_PRESS; break;
+        case BUTTON_EVENT_CHORD: buttons = event.buttons;                   break;
+        default: return;
+    }
+
+    lcd_transition_t transition;
+    for (uint8_t i = 0; i < sizeof(_transitions) / sizeof(_transitions[0]); i++) {
+        memcpy_P(&transition, &_transitions[i], sizeof(transition));
+
+        if (transition.buttons != buttons ||
+            (transition.mode != _currentMode && transition.mode != LCD_MODE_ANY)) {
+            continue;
+        }
 
-        // ---- this block is called repeatedly as long as the button is pushed
-        if (_didWaterFlow == false) {
-            _sendMessage(MSG_IS_WATER_POURING, &_didWaterFlow);
-            if (_didWaterFlow) {
-                _timeToStrawMillis = millis() - _strawFirstDownMillis;
-            }
+        if (transition.action != NULL && !(this->*transition.action)(event.millis)) {
+            return;
         }
 
+        if (transition.nextMode == LCD_MODE_SAME) {
+            refreshMode();
+        }
+        else {
+            setMode((lcd_mode_t) transition.nextMode);
+        }
         return;
     }
+}
+
+bool LcdManager::showFirstParam(unsigned long eventMillis)
+{
+    this->_modeState.showParam_index = 0;
+    return true;
+}
+
+bool LcdManager::showNextParam(unsigned long eventMillis)
+{
+    msg_get_param_count_t request;
+    sendMessage(request);
+
+    // then a screen per profile slot
+    int count = request.count;
+#ifdef PROFILING
+    count += PROFILE_SLOT_COUNT;
+#endif
+    this->_modeState.showParam_index =
+        (this->_modeState.showParam_index + 1) % count;
+    return true;
+}
+
+bool LcdManager::leaveParams(unsigned long eventMillis)
+{
+    // the schedules kept running, back to them
+    if (_schedules.getCount() > 0) {
+        this->_modeState.setUnits_adding = false;
+        updateAutomaticCountdown();
+        setMode(LCD_MODE_AUTOMATIC);
+        return false;
+    }
 
-    // ---- this is called only once
-    _didWaterFlow = false;
-    _strawFirstDownMillis = millis();
+    setDefaultMode();
+    return false;
+}
 
-    if (button == 3 && (
-        _currentMode == LCD_MODE_CALIBRATED ||
-        _currentMode == LCD_MODE_CALIBRATION
-    )) {
+bool LcdManager::showNewestHistory(unsigned long eventMillis)
+{
+    this->_modeState.history_index = 0;
+    return true;
+}
 
-        _sendMessage(MSG_MOTOR_DOWN, (void *) NULL);
+// back round to the newest after the oldest
+bool LcdManager::showOlderHistory(unsigned long eventMillis)
+{
+    msg_get_history_count_t request;
+    sendMessage(request);
+    this->_modeState.history_index++;
+    if (this->_modeState.history_index >= request.count) {
+        this->_modeState.history_index = 0;
     }
+    return true;
+}
 
-    _bitButtonStatusBefore |= (1 << (button - 1));
+bool LcdManager::startCalibration(unsigned long eventMillis)
+{
+    // this leaves automatic mode, a reset must not bring it back
+    cancelSchedules(eventMillis);
 
-    _previousButtonStatus[button-1] = HIGH;
+    this->_modeState.calibration_currentStep = 1;
+    this->_modeState.calibration_showEnd = false;
+    return true;
 }
 
-void LcdManager::onButtonReleased(int button) 
+bool LcdManager::endCalibration(unsigned long eventMillis)
 {
-    if (_previousButtonStatus[button-1] == LOW) {
-         return;
+    msg_calibration_end_t end;
+    sendMessage(end);
+
+    if (end.accepted) {
+        // the curve is in use already, writing it down can wait
+        msg_calibration_save_t save;
+        if (!_messages->post(save)) {
+            sendMessage(save);
+        }
+        return true;
     }
 
-    _previousButtonStatus[button-1] = LOW;
+    if (end.lowMemory) {
+        showMessage(PSTR("Low memory!"), 2000, LCD_MODE_CALIBRATION);
+        return false;
+    }
 
-    _bitButtonStatusAfter |= (1 << (button - 1));
+    // more points may fix it, Cancel keeps the old curve
+    showMessage(PSTR("Bad fit: retry!"), 2000, LCD_MODE_CALIBRATION);
+    return false;
+}
 
-    if (_bitButtonStatusBefore == _bitButtonStatusAfter) {
-        /*
-         * all buttons up!
-         */
+bool LcdManager::storeCalibrationPoint(unsigned long eventMillis)
+{
+    // timed by the sensor itself from when the straw went down
+    msg_get_time_to_straw_t timeToStraw;
+    sendMessage(timeToStraw);
+    _timeToStrawMillis = timeToStraw.timeToStrawMillis;
+
+    msg_motor_up_t motorUp;
+    if (_timeToStrawMillis < 0) {
+        // shown while the motor goes up
+        sendMessage(motorUp);
+        showMessage(PSTR("No Water!"), 2300, LCD_MODE_CALIBRATION);
+        return false;
+    }
 
-        // special case: calibration : first 2 buttons from left pressed
-        if (_bitButtonStatusBefore == 3) {
-            if (_currentMode == LCD_MODE_SHOW_PARAM_A ||
-                _currentMode == LCD_MODE_SHOW_PARAM_B ||
-                _currentMode == LCD_MODE_SHOW_PARAM_C) {
+    sendMessage(motorUp);
 
-                this->_modeState.calibration_currentStep = 1;
-                setMode(LCD_MODE_CALIBRATION);    
-                    
-            }
-            else {
-                setMode(LCD_MODE_SHOW_PARAM_A);    
-            }
-        }
+    msg_calibration_is_valid_t check;
+    check.timeToStrawMillis = _timeToStrawMillis;
+    check.strawDownMillis = (double) (eventMillis - _strawFirstDownMillis);
+    sendMessage(check);
+
+    if (!check.valid) {
+        showMessage(check.lowMemory ? PSTR("Low memory!") : PSTR("Invalid: retry!"),
+            1000, LCD_MODE_CALIBRATION);
+        return false;
+    }
+
+    msg_calibration_store_point_t point;
+    point.timeToStrawMillis = check.timeToStrawMillis;
+    point.strawDownMillis = check.strawDownMillis;
+    sendMessage(point);
+
+    this->_modeState.calibration_currentStep++;
+
+    if (this->_modeState.calibration_currentStep > 5) {
+        this->_modeState.calibration_showEnd = true;
+    }
+    return true;
+}
+
+bool LcdManager::strawDown(unsigned long eventMillis)
+{
+    _strawFirstDownMillis = eventMillis;
+    msg_motor_down_t motorDown;
+    sendMessage(motorDown);
+    return false;
+}
 
-        switch (_currentMode) {
-            case LCD_MODE_SHOW_PARAM_A:
-                switch (_bitButtonStatusBefore) {
-                    case 1: setDefaultMode(); break;
-                    case 4: setMode(LCD_MODE_SHOW_PARAM_B);
-                }
-                break; 
-
-            case LCD_MODE_SHOW_PARAM_B:
-                switch (_bitButtonStatusBefore) {
-                    case 1: setDefaultMode(); break;
-                    case 4: setMode(LCD_MODE_SHOW_PARAM_C);
-                }
-                break;
-
-            case LCD_MODE_SHOW_PARAM_C:
-                switch (_bitButtonStatusBefore) {
-                    case 1: setDefaultMode(); break;
-                    case 4: setMode(LCD_MODE_SHOW_PARAM_A);
-                }
-                break;
-
-            case LCD_MODE_CALIBRATED:
-                switch (_bitButtonStatusBefore) {
-                    case 1: setMode(LCD_MODE_SET_UNITS);                   break;
-                    case 2: _sendMessage(MSG_POUR_ONE_UNIT, (void *) NULL); break;
-                    case 4: _sendMessage(MSG_MOTOR_UP, (void *) NULL);      break;
-                }
-                break;
-
-            case LCD_MODE_CALIBRATION:
-                switch (_bitButtonStatusBefore) {
-
-                    case 1: 
-                        setMode(LCD_MODE_CALIBRATED);
-                        break; 
-
-                    case 2: // end calibration
-                        _sendMessage(MSG_CALIBRATION_END, (void *) NULL);
-                        _sendMessage(MSG_CALIBRATION_SAVE, (void *) NULL);
-                        setMode(LCD_MODE_CALIBRATED);
-                        break;
-
-                    case 4: 
-
-                        if (false == _didWaterFlow) {
-                            sprintf(this->_modeState.message_text, "No Water!");
-                            setMode(LCD_MODE_MESSAGE);
-
-                            // note all blocks while motor goes up
-                            _sendMessage(MSG_MOTOR_UP, (void *) NULL); 
-
-                            setMode(LCD_MODE_CALIBRATION);
-                        }
-                        else {
-                            double point[2];
-                            point[0] = (double) _timeToStrawMillis;
-                            point[1] = (double) (millis() - _strawFirstDownMillis);
-
-                            _sendMessage(MSG_MOTOR_UP, (void *) NULL); 
-
-                            // first param is the point to be checked
-                            // second param is an output param
-                            void *params[2];
-                            bool isValidCalibrationPoint;
-                            params[0] = (void *) point;
-                            params[1] = (void *) &isValidCalibrationPoint;
-
-                            _sendMessage(MSG_CALIBRATION_IS_VALID, params);
-
-                            if (isValidCalibrationPoint) {
-                                _sendMessage(MSG_CALIBRATION_STORE_POINT, point);
-
-                                this->_modeState.calibration_currentStep++;
-
-                                if (this->_modeState.calibration_currentStep > 5) {
-                                    this->_modeState.calibration_showEnd = true;
-                                }
-                            }
-                            else {
-                                // error
-                                sprintf(this->_modeState.message_text, "Invalid: retry!");
-                                setMode(LCD_MODE_MESSAGE);
-                                delay(1000);
-                                setMode(LCD_MODE_CALIBRATION);
-                            }
-
-                            refreshMode();
-                        }
-
-                        break;
-                }
-                break;
-
-            case LCD_MODE_SET_UNITS:
-                switch (_bitButtonStatusBefore) {
-                    case 1:
-                        // decrease units
-                        if (this->_modeState.setUnits_units > 1) {
-                            this->_modeState.setUnits_units--;
-                            refreshMode();
-                        }
-                        break;
-                    case 2:
-                        // increase units
-                        if (this->_modeState.setUnits_units < 9) {
-                            this->_modeState.setUnits_units++;
-                            refreshMode();
-                        }
-                        break;
-                    case 4:
-                        // go next
-
-                        /*
-                         * NOTE: we will read the desired setUnits_units
-                         * preference later, along with other preferences if
-                         * all is done.
-                         */
-                        setMode(LCD_MODE_SET_STARTAT);
-                        break;
-                }
-                break;
-
-            case LCD_MODE_SET_STARTAT:
-                switch (_bitButtonStatusBefore) {
-                    case 1:
-                        this->_modeState.setStartAt_minutes = decreaseMinutes(
-                            this->_modeState.setStartAt_minutes
-                        );
-                        refreshMode();
-                        break;
-                    
-                    case 2:
-                        this->_modeState.setStartAt_minutes = increaseMinutes(
-                            this->_modeState.setStartAt_minutes
-                        );
-                        refreshMode();
-                        break;
-                    case 4:
-                        // go next
-                        setMode(LCD_MODE_SET_EVERY);
-                        break;
-                }
-                break;
-
-            case LCD_MODE_SET_EVERY:
-                switch (_bitButtonStatusBefore) {
-                    case 1:
-                        this->_modeState.setEvery_minutes = decreaseMinutes(
-                            this->_modeState.setEvery_minutes
-                        );
-                        refreshMode();
-                        break;
-
-                    case 2:
-                        this->_modeState.setEvery_minutes = increaseMinutes(
-                            this->_modeState.setEvery_minutes
-                        );
-                        refreshMode();
-                        break;
-
-                    case 4:
-                        this->_modeState.automatic_units = this->_modeState.setUnits_units;
-                        this->_modeState.automatic_remainingMinutes = this->_modeState.setStartAt_minutes;
-
-                        _timePreferencesSaved = millis();
-                        setMode(LCD_MODE_AUTOMATIC);
-
-                        break;
-                }
-                break;
-
-            case LCD_MODE_AUTOMATIC:
-                if (_bitButtonStatusBefore == 1) {
-                    setMode(LCD_MODE_CALIBRATED);
-                }
-                break;
-        };
-
-        resetBitsStatus();
+bool LcdManager::strawUp(unsigned long eventMillis)
+{
+    msg_motor_up_t motorUp;
+    sendMessage(motorUp);
+    return false;
+}
+
+bool LcdManager::pourOneUnit(unsigned long eventMillis)
+{
+    msg_pour_units_t request;
+    request.units = 1;
+    sendMessage(request);
+    return false;
+}
+
+bool LcdManager::decreaseUnits(unsigned long eventMillis)
+{
+    if (this->_modeState.setUnits_units <= 1) {
+        return false;
     }
+    this->_modeState.setUnits_units--;
+    return true;
+}
+
+bool LcdManager::increaseUnits(unsigned long eventMillis)
+{
+    if (this->_modeState.setUnits_units >= 9) {
+        return false;
+    }
+    this->_modeState.setUnits_units++;
+    return true;
+}
+
+bool LcdManager::decreaseStartAt(unsigned long eventMillis)
+{
+    this->_modeState.setStartAt_minutes = decreaseMinutes(
+        this->_modeState.setStartAt_minutes
+    );
+    return true;
+}
+
+bool LcdManager::increaseStartAt(unsigned long eventMillis)
+{
+    this->_modeState.setStartAt_minutes = increaseMinutes(
+        this->_modeState.setStartAt_minutes
+    );
+    return true;
+}
+
+bool LcdManager::decreaseEvery(unsigned long eventMillis)
+{
+    this->_modeState.setEvery_minutes = decreaseMinutes(
+        this->_modeState.setEvery_minutes
+    );
+    return true;
+}
+
+bool LcdManager::increaseEvery(unsigned long eventMillis)
+{
+    this->_modeState.setEvery_minutes = increaseMinutes(
+        this->_modeState.setEvery_minutes
+    );
+    return true;
+}
+
+bool LcdManager::recordSchedule(unsigned long eventMillis)
+{
+    // Record starts over, Add keeps what is there
+    if (false == this->_modeState.setUnits_adding) {
+        _schedules.clear();
+        this->_modeState.automatic_unitsToPour = 0;
+    }
+    this->_modeState.setUnits_adding = false;
+
+    _schedules.add(
+        this->_modeState.setUnits_units,
+        millis() + this->_modeState.setStartAt_minutes * 60000UL,
+        this->_modeState.setEvery_minutes * 60000UL
+    );
+
+    saveSettings();
+    saveSchedule();
+    updateAutomaticCountdown();
+    return true;
+}
+
+bool LcdManager::cancelSchedules(unsigned long eventMillis)
+{
+    _schedules.clear();
+    this->_modeState.automatic_unitsToPour = 0;
+    saveSchedule();
+    return true;
 }
 
+bool LcdManager::addSchedule(unsigned long eventMillis)
+{
+    // another schedule next to the ones running
+    if (_schedules.getCount() >= SCHEDULE_HEAP_CAPACITY) {
+        return false;
+    }
+    this->_modeState.setUnits_adding = true;
+    return true;
+}
 
 int LcdManager::decreaseMinutes(int currentMinutes) {
     // decrease
@@ -565,37 +838,148 @@ int LcdManager::increaseMinutes(int currentMinutes) {
 
 void LcdManager::loop()
 {
-    /*
-     * In automatic mode we must decrease the next counter until it reaches 0.
-     */
+    PROFILE(PROFILE_LCD);
 
-    if (_currentMode == LCD_MODE_AUTOMATIC) {
+    button_event_t event;
+    while (_buttons->readEvent(&event)) {
+        PROFILE(PROFILE_BUTTONS);
+        onButtonEvent(event);
+    }
 
-        unsigned long  millisSincePreferencesSet = (millis() - _timePreferencesSaved);
+    loopSchedules();
+    loopMode();
 
-        int minutesPassed = (int) ((double)millisSincePreferencesSet / (double) 60000);
-        int minutesToGo = this->_modeState.automatic_remainingMinutes - minutesPassed;
-        if (minutesToGo != this->_modeState.automatic_remainingMinutes) {
-            this->_modeState.automatic_remainingMinutes = minutesToGo;
-            refreshMode();
-            _timePreferencesSaved = millis();
-        }
+    // a bounded slice of display traffic per call, however big the change
+    _frame.flush(&_queue);
+    _queue.drain(_lcd, LCD_BYTES_PER_LOOP);
+}
 
-        if (minutesToGo <= 0) {               // won't go through next time...
-            _timePreferencesSaved = millis(); // ... because we reset this one!
+void LcdManager::loopMode()
+{
+    lcd_hook_t loop;
+    memcpy_P(&loop, &_modeHooks[_currentMode].loop, sizeof(loop));
 
-            // pour the units
-            int howManyUnits = _modeState.automatic_units;
-            while (this->_modeState.automatic_units-- > 0) {
-                _sendMessage(MSG_POUR_ONE_UNIT, (void *)NULL);
-                refreshMode();
-                delay(2000);
-            }
+    if (loop != NULL) {
+        (this->*loop)();
+    }
+}
 
-            this->_modeState.automatic_remainingMinutes = this->_modeState.setEvery_minutes;
-            this->_modeState.automatic_units = howManyUnits;
+void LcdManager::loopModeMessage()
+{
+    if ((long) (millis() - this->_modeState.message_untilMillis) >= 0) {
+        setMode(this->_modeState.message_nextMode);
+    }
+}
 
-            refreshMode();
+/*
+ * The schedules run whatever the screen: those that fall due add their
+ * units to the batch being poured, also while another schedule is being
+ * added or the params are up.
+ */
+void LcdManager::loopSchedules()
+{
+    uint8_t dueUnits = _schedules.takeDue(millis());
+    if (dueUnits > 0) {
+        if (this->_modeState.automatic_unitsToPour == 0) {
+            _timeLastPourDone = millis() - AUTOMATIC_POUR_GAP_MILLIS;
+            _batchPourStarted = false;
+            this->_modeState.automatic_remainingMinutes = 0;
         }
+        this->_modeState.automatic_unitsToPour += dueUnits;
+    }
+
+    if (this->_modeState.automatic_unitsToPour > 0) {
+        loopAutomaticPour();
+        return;
+    }
+
+    if (_schedules.getCount() > 0 && (long) (millis() - _nextCheckpointMillis) >= 0) {
+        saveSchedule();
+    }
+}
+
+void LcdManager::loopModeAutomatic()
+{
+    if (this->_modeState.automatic_unitsToPour == 0 && updateAutomaticCountdown()) {
+        refreshMode();
+    }
+}
+
+/*
+ * Works out what the automatic screen shows from the next deadline,
+ * minutes rounded up. True if that changed.
+ */
+bool LcdManager::updateAutomaticCountdown()
+{
+    const schedule_entry_t *next = _schedules.peek();
+    if (next == NULL) {
+        return false;
+    }
+
+    int32_t millisToGo = (int32_t) (next->dueMillis - millis());
+    int minutesToGo = millisToGo > 0 ? (millisToGo + 59999) / 60000 : 0;
+
+    if (minutesToGo == this->_modeState.automatic_remainingMinutes &&
+        next->units == this->_modeState.automatic_units) {
+        return false;
+    }
+
+    this->_modeState.automatic_remainingMinutes = minutesToGo;
+    this->_modeState.automatic_units = next->units;
+    return true;
+}
+
+/*
+ * Pours the units of an automatic batch once the previous pour is done,
+ * as many as AUTOMATIC_POUR_MAX_UNITS at a time with a single straw
+ * motion. The display counts down the units left while the batch runs.
+ */
+void LcdManager::loopAutomaticPour()
+{
+    msg_is_pour_in_progress_t pouring;
+    sendMessage(pouring);
+    if (pouring.inProgress) {
+        _timeLastPourDone = millis();
+        return;
     }
+
+    if (millis() - _timeLastPourDone < AUTOMATIC_POUR_GAP_MILLIS) {
+        return;
+    }
+
+    // no point trying the rest of the batch, the next one will try again
+    msg_is_reservoir_empty_t reservoir;
+    reservoir.empty = false;
+    if (_batchPourStarted) {
+        sendMessage(reservoir);
+    }
+    if (reservoir.empty) {
+        this->_modeState.automatic_unitsToPour = 0;
+        updateAutomaticCountdown();
+        saveSchedule();
+        refreshMode();
+        return;
+    }
+
+    msg_pour_units_t request;
+    request.units = this->_modeState.automatic_unitsToPour;
+    if (request.units > AUTOMATIC_POUR_MAX_UNITS) {
+        request.units = AUTOMATIC_POUR_MAX_UNITS;
+    }
+    sendMessage(request);
+    if (!request.accepted) {
+        // the units stay in the batch, tried again after a gap
+        _timeLastPourDone = millis();
+        return;
+    }
+    _batchPourStarted = true;
+    this->_modeState.automatic_unitsToPour -= request.units;
+
+    if (this->_modeState.automatic_unitsToPour == 0) {
+        // that was the last one, count down to the next batch
+        updateAutomaticCountdown();
+    }
+
+    saveSchedule();
+    refreshMode();
 }
@@ -9,25 +9,41 @@
 
 #define DISPLAY_TIMEOUT_MILLIS 120000
 
+// LCD bytes sent per loop() call, about 0.27 ms each
+#define LCD_BYTES_PER_LOOP 2
+
+// pause between two pours in automatic mode
+#define AUTOMATIC_POUR_GAP_MILLIS 2000
+
+// units of a batch poured with the straw down once, 1 pours them one by one
+#ifndef AUTOMATIC_POUR_MAX_UNITS
+#define AUTOMATIC_POUR_MAX_UNITS 9
+#endif
+
+// the automatic countdown is checkpointed this often, see resumeSchedule()
+#define AUTOMATIC_CHECKPOINT_MINUTES 5
+
 #include "Arduino.h"
 #include <LiquidCrystal.h>
+#include <ButtonScanner.h>
+#include "LcdFrame.h"
+#include "LcdText.h"
+#include "LcdWriteQueue.h"
+#include "ScheduleHeap.h"
+#include <MessageBus.h>
+#include <Profiler.h>
 
-enum message_t {
-    MSG_INIT_MOTOR,
-    MSG_CALIBRATION_BEGIN,
-    MSG_CALIBRATION_STORE_POINT,
-    MSG_CALIBRATION_END,
-    MSG_MOTOR_DOWN,
-    MSG_MOTOR_UP,
-    MSG_POUR_ONE_UNIT,
-    MSG_IS_WATER_POURING,
-    MSG_GET_PARAM_A,
-    MSG_GET_PARAM_B,
-    MSG_GET_PARAM_C,
-    MSG_CALIBRATION_IS_VALID,
-    MSG_CALIBRATION_SAVE,
-    MSG_CALIBRATION_LOAD
-};
+// button bits as reported by the ButtonScanner
+#define BUTTON_BIT_1 1
+#define BUTTON_BIT_2 2
+#define BUTTON_BIT_3 4
+
+// in a transition: the buttons going down rather than the chord released
+#define LCD_EVENT_PRESS 0x80
+
+// in a transition: whatever the mode, or staying in it
+#define LCD_MODE_ANY 0xFF
+#define LCD_MODE_SAME 0xFE
 
 enum lcd_mode_t {
     LCD_MODE_CALIBRATION,
@@ -38,34 +54,257 @@ enum lcd_mode_t {
     LCD_MODE_SET_STARTAT,
     LCD_MODE_SET_EVERY,
     LCD_MODE_AUTOMATIC,
-    LCD_MODE_SHOW_PARAM_A,
-    LCD_MODE_SHOW_PARAM_B,
-    LCD_MODE_SHOW_PARAM_C
+    LCD_MODE_SHOW_PARAM,
+    LCD_MODE_HISTORY,
+
+    // number of modes, also the mode before the first screen is shown
+    LCD_MODE_COUNT
 };
 
+// the schedule last set up, saved and loaded with the settings
+typedef struct {
+    int16_t units;
+    int16_t startAtMinutes;
+    int16_t everyMinutes;
+} schedule_settings_t;
+
+// where automatic mode is, count is 0 if off
+typedef struct {
+    uint8_t unitsToPour;
+    uint8_t count;
+    struct {
+        uint8_t units;
+        int16_t everyMinutes;
+        int32_t remainingSeconds;
+    } schedules[SCHEDULE_HEAP_CAPACITY];
+} schedule_state_t;
+
+/*
+ * Messages sent to the sketch, which handles each of them. Fields are
+ * filled in by the sender, or by the handler where they are an answer.
+ */
+typedef struct {} msg_motor_down_t;
+typedef struct {} msg_motor_up_t;
+
+/*
+ * A single pour of units with the straw down once. accepted is false if
+ * it did not start: no curve, a pour still going or the straw moving.
+ */
+typedef struct {
+    uint8_t units;
+    bool accepted;
+} msg_pour_units_t;
+
+typedef struct {
+    bool inProgress;
+} msg_is_pour_in_progress_t;
+
+// the last pour found no water
+typedef struct {
+    bool empty;
+} msg_is_reservoir_empty_t;
+
+// -1 if the water did not get to the straw
+typedef struct {
+    double timeToStrawMillis;
+} msg_get_time_to_straw_t;
+
+typedef struct {
+    int count;
+} msg_get_param_count_t;
+
+typedef struct {
+    int index;
+    double value;
+} msg_get_param_t;
+
+typedef struct {
+    uint16_t count;
+} msg_get_history_count_t;
+
+/*
+ * A past pour, index 0 the newest; found is false past the oldest.
+ * minutesBefore is since the pour before, or since power-on if
+ * afterPowerOn.
+ */
+typedef struct {
+    uint16_t index;
+    bool found;
+    uint16_t minutesBefore;
+    uint8_t units;
+    bool afterPowerOn;
+    bool interrupted;
+    bool empty;
+    uint16_t timeToStrawMillis;
+    uint16_t downMillis;
+} msg_get_history_entry_t;
+
+typedef struct {} msg_calibration_begin_t;
+
+/*
+ * Whether the point may follow the ones stored so far; not valid with
+ * lowMemory either if fitting it in could run the stack into the heap.
+ */
+typedef struct {
+    double timeToStrawMillis;
+    double strawDownMillis;
+    bool valid;
+    bool lowMemory;
+} msg_calibration_is_valid_t;
+
+typedef struct {
+    double timeToStrawMillis;
+    double strawDownMillis;
+} msg_calibration_store_point_t;
+
+// whether the curve fitted to the points is good enough to use, or
+// lowMemory if there was not enough RAM left to finish the fit
+typedef struct {
+    bool accepted;
+    bool lowMemory;
+} msg_calibration_end_t;
+
+typedef struct {} msg_calibration_save_t;
+
+typedef struct {
+    bool loaded;
+} msg_calibration_load_t;
+
+typedef struct {
+    bool calibrated;
+} msg_is_calibrated_t;
+
+typedef struct {
+    schedule_settings_t settings;
+} msg_settings_save_t;
+
+// settings is left as it is if none were saved
+typedef struct {
+    schedule_settings_t settings;
+} msg_settings_load_t;
+
+typedef struct {
+    schedule_state_t state;
+} msg_schedule_save_t;
+
+// state is left as it is if none was saved
+typedef struct {
+    schedule_state_t state;
+} msg_schedule_load_t;
+
+// defined by the sketch
+template <> void onMessage(msg_motor_down_t &message);
+template <> void onMessage(msg_motor_up_t &message);
+template <> void onMessage(msg_pour_units_t &message);
+template <> void onMessage(msg_is_pour_in_progress_t &message);
+template <> void onMessage(msg_is_reservoir_empty_t &message);
+template <> void onMessage(msg_get_time_to_straw_t &message);
+template <> void onMessage(msg_get_param_count_t &message);
+template <> void onMessage(msg_get_param_t &message);
+template <> void onMessage(msg_get_history_count_t &message);
+template <> void onMessage(msg_get_history_entry_t &message);
+template <> void onMessage(msg_calibration_begin_t &message);
+template <> void onMessage(msg_calibration_is_valid_t &message);
+template <> void onMessage(msg_calibration_store_point_t &message);
+template <> void onMessage(msg_calibration_end_t &message);
+template <> void onMessage(msg_calibration_save_t &message);
+template <> void onMessage(msg_calibration_load_t &message);
+template <> void onMessage(msg_is_calibrated_t &message);
+template <> void onMessage(msg_settings_save_t &message);
+template <> void onMessage(msg_settings_load_t &message);
+template <> void onMessage(msg_schedule_save_t &message);
+template <> void onMessage(msg_schedule_load_t &message);
+
 class LcdManager 
 {
     public:
-        LcdManager(LiquidCrystal *lcd, void (*notifyFunc) (message_t, void *param));
+        LcdManager(LiquidCrystal *lcd, ButtonScanner *buttons, MessageQueue *messages);
         void begin();
-        void onButtonPressed(int button);
-        void onButtonReleased(int button);
         void loop();
+
+        // shows msg, kept in flash, for a while, then goes back to the current screen
+        void showMessage(PGM_P msg, unsigned long durationMillis);
     private:
+        /*
+         * What a button event does in a mode: the action runs, if any,
+         * and unless it returns false the screen goes to nextMode, or is
+         * redrawn for LCD_MODE_SAME. buttons is as in the chord event,
+         * with LCD_EVENT_PRESS set for a button going down.
+         */
+        typedef bool (LcdManager::*lcd_action_t)(unsigned long eventMillis);
+        typedef struct {
+            uint8_t mode;
+            uint8_t buttons;
+            uint8_t nextMode;
+            lcd_action_t action;
+        } lcd_transition_t;
+
+        // what a mode does when entered, to draw itself and from loop()
+        typedef void (LcdManager::*lcd_hook_t)();
+        typedef struct {
+            lcd_hook_t enter;
+            lcd_hook_t render;
+            lcd_hook_t loop;
+        } lcd_mode_hooks_t;
+
+        // both in flash
+        static const lcd_transition_t _transitions[];
+        static const lcd_mode_hooks_t _modeHooks[LCD_MODE_COUNT];
+
         // keeps the current screen displayed
         lcd_mode_t _currentMode;
 
-        void resetBitsStatus();
-        void drawModeMessage(char *msg);
-        void drawModeCalibration(int progress, bool showEnd);
+        void onButtonEvent(const button_event_t &event);
+        void showMessage(PGM_P msg, unsigned long durationMillis, lcd_mode_t nextMode);
+        void loopMode();
+        void loopModeMessage();
+        void loopModeAutomatic();
+        void loopSchedules();
+        void loopAutomaticPour();
+        void enterModeCalibration();
+        void enterModeCalibrated();
+        void drawModeMessage();
+        void drawModeCalibration();
         void drawModeCalibrated();
-        void drawModeSetUnits(int displayUnits);
-        void drawEveryMinutes(int minutes);
-        void drawStartAtMinutes(int minutes);
-        void drawModeAutomatic(int units, int remainingMinutes);
-        void drawModeShowParam(char paramName, double paramValue);
+        void drawModeSetUnits();
+        void drawModeSetStartAt();
+        void drawModeSetEvery();
+        void drawModeAutomatic();
+        void drawModeShowParam();
+#ifdef PROFILING
+        void drawProfile(uint8_t slot);
+        void printMicros(LcdText &text, uint32_t micros);
+#endif
+        void drawModeHistory();
         void setMode(lcd_mode_t mode);
+
+        // transition actions
+        bool showFirstParam(unsigned long eventMillis);
+        bool showNextParam(unsigned long eventMillis);
+        bool leaveParams(unsigned long eventMillis);
+        bool showNewestHistory(unsigned long eventMillis);
+        bool showOlderHistory(unsigned long eventMillis);
+        bool startCalibration(unsigned long eventMillis);
+        bool endCalibration(unsigned long eventMillis);
+        bool storeCalibrationPoint(unsigned long eventMillis);
+        bool strawDown(unsigned long eventMillis);
+        bool strawUp(unsigned long eventMillis);
+        bool pourOneUnit(unsigned long eventMillis);
+        bool decreaseUnits(unsigned long eventMillis);
+        bool increaseUnits(unsigned long eventMillis);
+        bool decreaseStartAt(unsigned long eventMillis);
+        bool increaseStartAt(unsigned long eventMillis);
+        bool decreaseEvery(unsigned long eventMillis);
+        bool increaseEvery(unsigned long eventMillis);
+        bool recordSchedule(unsigned long eventMillis);
+        bool cancelSchedules(unsigned long eventMillis);
+        bool addSchedule(unsigned long eventMillis);
         void setDefaultMode();
+        void loadSettings();
+        void saveSettings();
+        void saveSchedule();
+        void resumeSchedule();
+        bool updateAutomaticCountdown();
         void refreshMode();
 
         int decreaseMinutes(int currentMinutes);
@@ -73,26 +312,35 @@ class LcdManager
 
         LiquidCrystal *_lcd;
 
-        // the messaging bus
-        void (*_sendMessage)(message_t, void *);
+        // what the display shows, see setMode()
+        LcdFrame _frame;
 
-        // byte fields used to detect which buttons are pressed
-        int _bitButtonStatusAfter;
-        int _bitButtonStatusBefore;
+        // changes to the frame on their way to the display
+        LcdWriteQueue _queue;
 
-        int _previousButtonStatus[3] = {LOW, LOW, LOW};
+        // where the button events come from
+        ButtonScanner *_buttons;
 
-        // used to detect water flowing between button press
-        bool _didWaterFlow;
+        // for messages that need not be handled right away
+        MessageQueue *_messages;
 
         // time the straw went down
         unsigned long _strawFirstDownMillis;
 
         // time the water took to reach the straw
-        unsigned long _timeToStrawMillis;
+        double _timeToStrawMillis;
+
+        // automatic mode, by next deadline
+        ScheduleHeap _schedules;
+
+        // when automatic mode is next checkpointed
+        unsigned long _nextCheckpointMillis;
+
+        // time the last unit poured in automatic mode was done
+        unsigned long _timeLastPourDone;
 
-        // time at which the preferences were first saved
-        unsigned long _timePreferencesSaved;
+        // a pour of the current batch was started
+        bool _batchPourStarted;
 
         // decomposes minutes into days, hours, minutes
         void decomposeMinutes(int inMinutes, int *outDays, int *outHours, int *outMinutes);
@@ -113,11 +361,17 @@ class LcdManager
             int calibration_currentStep;
             bool calibration_showEnd;
             int setUnits_units;
+            bool setUnits_adding;
             int setStartAt_minutes;
             int setEvery_minutes;
             int automatic_units;
             int automatic_remainingMinutes;
-            char * message_text = "                ";
+            int automatic_unitsToPour;
+            int showParam_index;
+            uint16_t history_index;
+            PGM_P message_text;
+            unsigned long message_untilMillis;
+            lcd_mode_t message_nextMode;
         } _modeState;
 };
 
@@ -0,0 +1,67 @@
+/*
+ * LcdText.cpp - Builds a line of text for a 16x2 character display.
+ * Released into the public domain.
+ */
+
+#include "LcdText.h"
+#include "Arduino.h"
+
+LcdText::LcdText(char *buffer)
+{
+    _buffer = buffer;
+    _length = 0;
+    _buffer[0] = '\0';
+}
+
+LcdText &LcdText::label(PGM_P text)
+{
+    char c;
+    while ((c = pgm_read_byte(text++)) != '\0') {
+        append(c);
+    }
+    return *this;
+}
+
+/*
+ * The digits come out last first. 32 bit divisions are slow on the AVR,
+ * they only go on until the rest fits in 16 bits.
+ */
+LcdText &LcdText::number(long value)
+{
+    char digits[10];
+    uint8_t count = 0;
+    uint32_t magnitude = value < 0 ? -(uint32_t) value : value;
+
+    while (magnitude > 0xFFFF) {
+        digits[count++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    }
+
+    uint16_t rest = magnitude;
+    do {
+        digits[count++] = '0' + rest % 10;
+        rest /= 10;
+    } while (rest > 0);
+
+    if (value < 0) {
+        append('-');
+    }
+    while (count > 0) {
+        append(digits[--count]);
+    }
+    return *this;
+}
+
+const char *LcdText::get()
+{
+    return _buffer;
+}
+
+void LcdText::append(char c)
+{
+    if (_length >= LCD_TEXT_SIZE - 1) {
+        return;
+    }
+    _buffer[_length++] = c;
+    _buffer[_length] = '\0';
+}
@@ -0,0 +1,44 @@
+/*
+ * LcdText.h - Builds a line of text for a 16x2 character display.
+ * Released into the public domain.
+ */
+
+#ifndef LcdText_h
+#define LcdText_h
+
+#include "Arduino.h"
+#include "LcdFrame.h"
+
+// a whole line and its terminating NUL
+#define LCD_TEXT_SIZE (LCD_FRAME_COLS + 1)
+
+/*
+ * Fills a buffer of LCD_TEXT_SIZE bytes owned by the caller with labels
+ * kept in flash and integers, in place of sprintf. Numbers are long so
+ * that unsigned and 32 bit values print right too:
+ *
+ *   char line[LCD_TEXT_SIZE];
+ *   LcdText(line).label(PSTR("Pour ")).number(units).label(PSTR(" units"));
+ *
+ * Whatever does not fit on the line is cut off, and the text is always
+ * terminated.
+ */
+class LcdText
+{
+    public:
+        LcdText(char *buffer);
+
+        LcdText &label(PGM_P text);
+
+        LcdText &number(long value);
+
+        const char *get();
+
+    private:
+        void append(char c);
+
+        char *_buffer;
+        uint8_t _length;
+};
+
+#endif
@@ -0,0 +1,61 @@
+/*
+ * LcdWriteQueue.cpp - Queue of writes to a character display, sent a few at a time.
+ * Released into the public domain.
+ */
+
+#include "LcdWriteQueue.h"
+#include "Arduino.h"
+
+#define LCD_ENTRY_CURSOR 0x80
+#define LCD_ENTRY_ROW_1 0x40
+
+LcdWriteQueue::LcdWriteQueue()
+{
+    _head = 0;
+    _tail = 0;
+}
+
+uint8_t LcdWriteQueue::getFree()
+{
+    return (_tail - _head - 1) & (LCD_WRITE_QUEUE_SIZE - 1);
+}
+
+bool LcdWriteQueue::isEmpty()
+{
+    return _head == _tail;
+}
+
+void LcdWriteQueue::setCursor(uint8_t col, uint8_t row)
+{
+    push(LCD_ENTRY_CURSOR | (row ? LCD_ENTRY_ROW_1 : 0) | (col & 0x3F));
+}
+
+void LcdWriteQueue::write(uint8_t c)
+{
+    push(c & 0x7F);
+}
+
+void LcdWriteQueue::push(uint8_t entry)
+{
+    if (getFree() == 0) {
+        return;
+    }
+
+    _entries[_head] = entry;
+    _head = (_head + 1) & (LCD_WRITE_QUEUE_SIZE - 1);
+}
+
+void LcdWriteQueue::drain(LiquidCrystal *lcd, uint8_t maxBytes)
+{
+    while (maxBytes-- > 0 && _tail != _head) {
+        uint8_t entry = _entries[_tail];
+        _tail = (_tail + 1) & (LCD_WRITE_QUEUE_SIZE - 1);
+
+        if (entry & LCD_ENTRY_CURSOR) {
+            lcd->setCursor(entry & 0x3F, (entry & LCD_ENTRY_ROW_1) ? 1 : 0);
+        }
+        else {
+            lcd->write(entry);
+        }
+    }
+}
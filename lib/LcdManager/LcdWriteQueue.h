@@ -0,0 +1,50 @@
+/*
+ * LcdWriteQueue.h - Queue of writes to a character display, sent a few at a time.
+ * Released into the public domain.
+ */
+
+#ifndef LcdWriteQueue_h
+#define LcdWriteQueue_h
+
+#include "Arduino.h"
+#include <LiquidCrystal.h>
+
+// must be a power of two, at most 128
+#ifndef LCD_WRITE_QUEUE_SIZE
+#define LCD_WRITE_QUEUE_SIZE 16
+#endif
+
+/*
+ * Each byte sent to an HD44780 in 4-bit mode blocks for about a quarter
+ * of a millisecond. Writes are queued here and drain() sends at most a
+ * given number per call, which bounds how long one call can hold up the
+ * rest of the loop however much of the screen changes.
+ *
+ * Entries below 0x80 are characters; the others move the cursor to the
+ * display address in their low 7 bits, like the controller's own
+ * "set DDRAM address" command.
+ */
+class LcdWriteQueue
+{
+    public:
+        LcdWriteQueue();
+
+        // room left, in entries; setCursor and write take one each
+        uint8_t getFree();
+        bool isEmpty();
+
+        void setCursor(uint8_t col, uint8_t row);
+        void write(uint8_t c);
+
+        // sends up to maxBytes entries to the display
+        void drain(LiquidCrystal *lcd, uint8_t maxBytes);
+
+    private:
+        void push(uint8_t entry);
+
+        uint8_t _entries[LCD_WRITE_QUEUE_SIZE];
+        uint8_t _head;
+        uint8_t _tail;
+};
+
+#endif
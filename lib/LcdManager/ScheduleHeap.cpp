@@ -0,0 +1,107 @@
+/*
+ * ScheduleHeap.cpp - Periodic schedules kept in order of their next deadline.
+ * Released into the public domain.
+ */
+
+#include "ScheduleHeap.h"
+
+ScheduleHeap::ScheduleHeap()
+{
+    _count = 0;
+}
+
+void ScheduleHeap::clear()
+{
+    _count = 0;
+}
+
+bool ScheduleHeap::add(uint8_t units, uint32_t dueMillis, uint32_t periodMillis)
+{
+    if (_count == SCHEDULE_HEAP_CAPACITY || periodMillis == 0) {
+        return false;
+    }
+
+    _entries[_count].dueMillis = dueMillis;
+    _entries[_count].periodMillis = periodMillis;
+    _entries[_count].units = units;
+    _count++;
+    siftUp(_count - 1);
+    return true;
+}
+
+uint8_t ScheduleHeap::getCount()
+{
+    return _count;
+}
+
+const schedule_entry_t *ScheduleHeap::peek()
+{
+    return _count > 0 ? &_entries[0] : NULL;
+}
+
+const schedule_entry_t *ScheduleHeap::get(uint8_t i)
+{
+    return i < _count ? &_entries[i] : NULL;
+}
+
+uint8_t ScheduleHeap::takeDue(uint32_t nowMillis)
+{
+    uint8_t units = 0;
+
+    while (_count > 0 && (int32_t) (nowMillis - _entries[0].dueMillis) >= 0) {
+        units += _entries[0].units;
+
+        do {
+            _entries[0].dueMillis += _entries[0].periodMillis;
+        } while ((int32_t) (nowMillis - _entries[0].dueMillis) >= 0);
+
+        siftDown(0);
+    }
+
+    return units;
+}
+
+bool ScheduleHeap::isBefore(const schedule_entry_t &a, const schedule_entry_t &b)
+{
+    return (int32_t) (a.dueMillis - b.dueMillis) < 0;
+}
+
+void ScheduleHeap::swap(uint8_t i, uint8_t j)
+{
+    schedule_entry_t entry = _entries[i];
+    _entries[i] = _entries[j];
+    _entries[j] = entry;
+}
+
+void ScheduleHeap::siftUp(uint8_t i)
+{
+    while (i > 0) {
+        uint8_t parent = (i - 1) / 2;
+        if (false == isBefore(_entries[i], _entries[parent])) {
+            break;
+        }
+        swap(i, parent);
+        i = parent;
+    }
+}
+
+void ScheduleHeap::siftDown(uint8_t i)
+{
+    for (;;) {
+        uint8_t smallest = i;
+        uint8_t left = 2 * i + 1;
+        uint8_t right = left + 1;
+
+        if (left < _count && isBefore(_entries[left], _entries[smallest])) {
+            smallest = left;
+        }
+        if (right < _count && isBefore(_entries[right], _entries[smallest])) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            break;
+        }
+        swap(i, smallest);
+        i = smallest;
+    }
+}
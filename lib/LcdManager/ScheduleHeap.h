@@ -0,0 +1,60 @@
+/*
+ * ScheduleHeap.h - Periodic schedules kept in order of their next deadline.
+ * Released into the public domain.
+ */
+
+#ifndef ScheduleHeap_h
+#define ScheduleHeap_h
+
+#include "Arduino.h"
+
+#ifndef SCHEDULE_HEAP_CAPACITY
+#define SCHEDULE_HEAP_CAPACITY 4
+#endif
+
+typedef struct {
+    uint32_t dueMillis;
+    uint32_t periodMillis;
+    uint8_t units;
+} schedule_entry_t;
+
+/*
+ * A binary min-heap on dueMillis. Deadlines are absolute millis() values
+ * and move on by exactly one period each time they are taken, so however
+ * late a schedule is noticed the next deadline does not move with it.
+ * Comparisons go through a signed difference, which keeps them right
+ * across the millis() rollover as long as deadlines are less than
+ * 24 days away.
+ */
+class ScheduleHeap
+{
+    public:
+        ScheduleHeap();
+        void clear();
+        bool add(uint8_t units, uint32_t dueMillis, uint32_t periodMillis);
+        uint8_t getCount();
+
+        // the next one due, NULL if there are none
+        const schedule_entry_t *peek();
+
+        // in no particular order, for saving them
+        const schedule_entry_t *get(uint8_t i);
+
+        /*
+         * Units of every schedule due at nowMillis, each then moved to its
+         * next deadline after nowMillis: periods missed altogether (the
+         * loop was held up for longer than one) are skipped, not poured.
+         */
+        uint8_t takeDue(uint32_t nowMillis);
+
+    private:
+        static bool isBefore(const schedule_entry_t &a, const schedule_entry_t &b);
+        void swap(uint8_t i, uint8_t j);
+        void siftUp(uint8_t i);
+        void siftDown(uint8_t i);
+
+        schedule_entry_t _entries[SCHEDULE_HEAP_CAPACITY];
+        uint8_t _count;
+};
+
+#endif
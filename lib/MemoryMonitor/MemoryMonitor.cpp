@@ -0,0 +1,52 @@
+/*
+ * MemoryMonitor.cpp - Library for watching free RAM and how deep the stack goes.
+ * Released into the public domain.
+ */
+
+#include "MemoryMonitor.h"
+
+// from the linker and avr-libc's malloc()
+extern uint8_t _end;
+extern uint8_t __heap_start;
+extern char *__brkval;
+
+/*
+ * Runs from .init3: after the stack pointer and the zero register are
+ * set up, before the static data is copied in, and with nothing on the
+ * stack yet. Naked, so it falls through to the next init section.
+ */
+void paintMemory() __attribute__((naked, used, section(".init3")));
+
+void paintMemory()
+{
+    uint8_t *p = &_end;
+    while (p <= (uint8_t *) RAMEND) {
+        *p++ = MEMORY_MONITOR_PAINT;
+    }
+}
+
+static uint8_t *heapEnd()
+{
+    return __brkval != NULL ? (uint8_t *) __brkval : &__heap_start;
+}
+
+uint16_t MemoryMonitor::getFreeMemory()
+{
+    uint8_t top;
+    return &top - heapEnd();
+}
+
+uint16_t MemoryMonitor::getUnusedStack()
+{
+    uint8_t *p = heapEnd();
+    uint8_t top;
+    while (p < &top && *p == MEMORY_MONITOR_PAINT) {
+        p++;
+    }
+    return p - heapEnd();
+}
+
+uint16_t MemoryMonitor::getStackHighWater()
+{
+    return (uint8_t *) RAMEND + 1 - heapEnd() - getUnusedStack();
+}
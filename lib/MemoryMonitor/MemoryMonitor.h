@@ -0,0 +1,35 @@
+/*
+ * MemoryMonitor.h - Library for watching free RAM and how deep the stack goes.
+ * Released into the public domain.
+ */
+
+#ifndef MemoryMonitor_h
+#define MemoryMonitor_h
+
+#include "Arduino.h"
+
+// what free RAM is painted with at boot
+#define MEMORY_MONITOR_PAINT 0xC5
+
+/*
+ * The RAM between the static data and the top of RAM is painted before
+ * main() runs. The stack wipes the paint off wherever it reaches, so
+ * what is still painted above the heap is how close it has ever come.
+ * Nothing in the sketch calls malloc(), but if something did the heap
+ * would be counted as used, as it should.
+ */
+class MemoryMonitor
+{
+    public:
+        // between the top of the heap and the stack pointer, right now
+        static uint16_t getFreeMemory();
+
+        // never reached by the stack since boot; scans up to 2 KB, so
+        // not something to call from every loop()
+        static uint16_t getUnusedStack();
+
+        // the most the stack has taken since boot
+        static uint16_t getStackHighWater();
+};
+
+#endif
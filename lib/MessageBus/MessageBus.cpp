@@ -0,0 +1,37 @@
+/*
+ * MessageBus.cpp - Library for typed messages between a library and the sketch.
+ * Released into the public domain.
+ */
+
+#include "MessageBus.h"
+#include "Arduino.h"
+
+MessageQueue::MessageQueue()
+{
+    _head = 0;
+    _count = 0;
+    _dropped = 0;
+}
+
+void MessageQueue::dispatch()
+{
+    // a handler may post again, that waits for the next call
+    uint8_t count = _count;
+
+    while (count-- > 0) {
+        uint8_t payload[MESSAGE_QUEUE_PAYLOAD_SIZE];
+        deliver_t deliver = _messages[_head].deliver;
+        memcpy(payload, _messages[_head].payload, sizeof(payload));
+
+        // freed before the handler runs, so that it can post
+        _head = (_head + 1) % MESSAGE_QUEUE_CAPACITY;
+        _count--;
+
+        deliver(payload);
+    }
+}
+
+uint8_t MessageQueue::getDroppedMessages()
+{
+    return _dropped;
+}
@@ -0,0 +1,104 @@
+/*
+ * MessageBus.h - Library for typed messages between a library and the sketch.
+ * Released into the public domain.
+ */
+
+#ifndef MessageBus_h
+#define MessageBus_h
+
+#include "Arduino.h"
+#include <Profiler.h>
+
+#ifndef MESSAGE_QUEUE_CAPACITY
+#define MESSAGE_QUEUE_CAPACITY 2
+#endif
+
+// the largest message that can be posted
+#ifndef MESSAGE_QUEUE_PAYLOAD_SIZE
+#define MESSAGE_QUEUE_PAYLOAD_SIZE 8
+#endif
+
+/*
+ * A message is a plain struct, its fields both what is asked and what
+ * comes back. Whoever handles it defines the handler for its type:
+ *
+ *   template <> void onMessage(msg_pour_units_t &message) { ... }
+ *
+ * and sendMessage(message) is then a direct call to that handler,
+ * chosen by the compiler from the type and inlined with link time
+ * optimisation. A message nobody handles fails to link.
+ */
+template <class Message>
+void onMessage(Message &message);
+
+template <class Message>
+inline void sendMessage(Message &message)
+{
+    PROFILE(PROFILE_MESSAGES);
+    onMessage(message);
+}
+
+/*
+ * Messages that need no answer can be posted instead, to be handled
+ * later from dispatch(), in the order they were posted. The message is
+ * copied, so it has to fit MESSAGE_QUEUE_PAYLOAD_SIZE.
+ */
+class MessageQueue
+{
+    public:
+        MessageQueue();
+
+        // false if the queue is full
+        template <class Message>
+        bool post(const Message &message);
+
+        // handles what was posted; call it from loop()
+        void dispatch();
+
+        // number of messages posted to a full queue
+        uint8_t getDroppedMessages();
+
+    private:
+        typedef void (*deliver_t)(const uint8_t *payload);
+
+        template <class Message>
+        static void deliver(const uint8_t *payload);
+
+        struct {
+            deliver_t deliver;
+            uint8_t payload[MESSAGE_QUEUE_PAYLOAD_SIZE];
+        } _messages[MESSAGE_QUEUE_CAPACITY];
+
+        uint8_t _head;
+        uint8_t _count;
+        uint8_t _dropped;
+};
+
+template <class Message>
+bool MessageQueue::post(const Message &message)
+{
+    static_assert(sizeof(Message) <= MESSAGE_QUEUE_PAYLOAD_SIZE,
+        "message too big for MESSAGE_QUEUE_PAYLOAD_SIZE");
+
+    if (_count == MESSAGE_QUEUE_CAPACITY) {
+        _dropped++;
+        return false;
+    }
+
+    uint8_t tail = (_head + _count) % MESSAGE_QUEUE_CAPACITY;
+    _messages[tail].deliver = &MessageQueue::deliver<Message>;
+    memcpy(_messages[tail].payload, &message, sizeof(Message));
+    _count++;
+    return true;
+}
+
+template <class Message>
+void MessageQueue::deliver(const uint8_t *payload)
+{
+    // copied out, the payload bytes need not be aligned for Message
+    Message message;
+    memcpy(&message, payload, sizeof(Message));
+    sendMessage(message);
+}
+
+#endif
@@ -0,0 +1,145 @@
+/*
+ * DispatchBenchmark.ino - Times sending a message the way LcdManager used
+ * to, through a function pointer to a switch on the message id with a
+ * void * payload, against sendMessage() and against post() + dispatch(),
+ * and reports cycles per message over Serial.
+ * Released into the public domain.
+ */
+
+#include <MessageBus.h>
+
+#define CALLS 1000
+
+// keeps the compiler from dropping the calls being timed
+volatile uint8_t sink;
+
+/*
+ * The old way: one handler for every message, the payload cast back
+ * from void * by whoever knows what it is.
+ */
+enum message_t {
+    MSG_IS_POUR_IN_PROGRESS,
+    MSG_POUR_UNITS,
+    MSG_GET_PARAM_COUNT
+};
+
+void onMessageSwitch(message_t action, void *param)
+{
+    switch (action) {
+        case MSG_IS_POUR_IN_PROGRESS:
+            *((bool *) param) = sink & 1;
+            break;
+        case MSG_POUR_UNITS:
+            sink = *((uint8_t *) param);
+            break;
+        case MSG_GET_PARAM_COUNT:
+            *((int *) param) = 3;
+            break;
+    }
+}
+
+// held by the sender, as LcdManager did
+void (*volatile notify)(message_t, void *) = onMessageSwitch;
+
+/*
+ * The typed way, with a handler per message type.
+ */
+typedef struct {
+    bool inProgress;
+} msg_is_pour_in_progress_t;
+
+typedef struct {
+    uint8_t units;
+} msg_pour_units_t;
+
+template <> void onMessage(msg_is_pour_in_progress_t &message)
+{
+    message.inProgress = sink & 1;
+}
+
+template <> void onMessage(msg_pour_units_t &message)
+{
+    sink = message.units;
+}
+
+MessageQueue Messages;
+
+unsigned long timeSwitch()
+{
+    unsigned long start = micros();
+    for (int i=0; i<CALLS; i++) {
+        bool pouring;
+        uint8_t units = i;
+        notify(MSG_IS_POUR_IN_PROGRESS, &pouring);
+        notify(MSG_POUR_UNITS, &units);
+        sink = pouring;
+    }
+    return micros() - start;
+}
+
+unsigned long timeSend()
+{
+    unsigned long start = micros();
+    for (int i=0; i<CALLS; i++) {
+        msg_is_pour_in_progress_t pouring;
+        msg_pour_units_t request;
+        request.units = i;
+        sendMessage(pouring);
+        sendMessage(request);
+        sink = pouring.inProgress;
+    }
+    return micros() - start;
+}
+
+// only the pour is posted, the question needs its answer right away
+unsigned long timePost()
+{
+    unsigned long start = micros();
+    for (int i=0; i<CALLS; i++) {
+        msg_is_pour_in_progress_t pouring;
+        msg_pour_units_t request;
+        request.units = i;
+        sendMessage(pouring);
+        Messages.post(request);
+        Messages.dispatch();
+        sink = pouring.inProgress;
+    }
+    return micros() - start;
+}
+
+unsigned long timeLoop()
+{
+    unsigned long start = micros();
+    for (int i=0; i<CALLS; i++) {
+        sink = i;
+        sink = i;
+    }
+    return micros() - start;
+}
+
+void printCycles(const char *label, unsigned long elapsedMicros, unsigned long loopMicros)
+{
+    Serial.print(label);
+    Serial.println((elapsedMicros - loopMicros) * (F_CPU / 1000000L) / (2 * CALLS));
+}
+
+void setup()
+{
+    Serial.begin(9600);
+
+    // the loop itself is taken off, two messages per pass
+    unsigned long loopMicros = timeLoop();
+    unsigned long switchMicros = timeSwitch();
+    unsigned long sendMicros = timeSend();
+    unsigned long postMicros = timePost();
+
+    printCycles("switch cycles/message: ", switchMicros, loopMicros);
+    printCycles("sendMessage() cycles/message: ", sendMicros, loopMicros);
+    printCycles("post() + dispatch() cycles/message: ", postMicros, loopMicros);
+    Serial.print("dropped: ");
+    Serial.println(Messages.getDroppedMessages());
+}
+
+void loop()
+{
+}
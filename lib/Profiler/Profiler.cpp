@@ -0,0 +1,140 @@
+/*
+ * Profiler.cpp - Library for timing the hot paths, built in with -DPROFILING.
+ * Released into the public domain.
+ */
+
+#include "Profiler.h"
+
+#ifdef PROFILING
+
+#include <avr/interrupt.h>
+
+Profiler Profile;
+
+static const char nameLoop[] PROGMEM = "Loop";
+static const char nameLcd[] PROGMEM = "Lcd";
+static const char nameButtons[] PROGMEM = "Button";
+static const char nameRealtime[] PROGMEM = "Realtm";
+static const char nameMessages[] PROGMEM = "Msg";
+static const char namePour[] PROGMEM = "Pour";
+static const char nameFit[] PROGMEM = "Fit";
+static const char nameEstimate[] PROGMEM = "Estim";
+
+// in profile_slot_t order
+static PGM_P const names[PROFILE_SLOT_COUNT] PROGMEM = {
+    nameLoop, nameLcd, nameButtons, nameRealtime,
+    nameMessages, namePour, nameFit, nameEstimate
+};
+
+ISR(TIMER2_OVF_vect) {
+    Profile.onOverflow();
+}
+
+Profiler::Profiler()
+{
+    memset(_slots, 0, sizeof(_slots));
+    _overflows = 0;
+}
+
+void Profiler::begin()
+{
+    TCCR2A = 0;
+    TCCR2B = (1 << CS21) | (1 << CS20);
+    TIMSK2 |= (1 << TOIE2);
+}
+
+/*
+ * The overflow count is read again to catch the interrupt coming in
+ * between; an overflow not handled yet shows as the flag still set.
+ */
+uint32_t Profiler::now()
+{
+    uint16_t overflows;
+    uint8_t count;
+    do {
+        overflows = _overflows;
+        count = TCNT2;
+    } while (overflows != _overflows);
+
+    if ((TIFR2 & (1 << TOV2)) && count < 0x80) {
+        overflows++;
+    }
+    return ((uint32_t) overflows << 8) | count;
+}
+
+void Profiler::record(uint8_t slot, uint32_t ticks)
+{
+    uint8_t bucket = 0;
+    uint32_t bound = PROFILE_FIRST_BOUND_MICROS / PROFILE_MICROS_PER_TICK;
+    while (bucket < PROFILE_BUCKETS - 1 && ticks >= bound) {
+        bucket++;
+        bound <<= 2;
+    }
+
+    uint16_t *buckets = _slots[slot].buckets;
+    // rounded up, a rare long time is not halved away
+    if (buckets[bucket] == 0xFFFF) {
+        for (uint8_t i = 0; i < PROFILE_BUCKETS; i++) {
+            buckets[i] = (buckets[i] + 1) >> 1;
+        }
+    }
+    buckets[bucket]++;
+
+    if (ticks > _slots[slot].maxTicks) {
+        _slots[slot].maxTicks = ticks;
+    }
+}
+
+uint32_t Profiler::getCount(uint8_t slot)
+{
+    uint32_t count = 0;
+    for (uint8_t i = 0; i < PROFILE_BUCKETS; i++) {
+        count += _slots[slot].buckets[i];
+    }
+    return count;
+}
+
+uint32_t Profiler::getMaxMicros(uint8_t slot)
+{
+    return _slots[slot].maxTicks * PROFILE_MICROS_PER_TICK;
+}
+
+const uint16_t *Profiler::getBuckets(uint8_t slot)
+{
+    return _slots[slot].buckets;
+}
+
+uint8_t Profiler::getP99Bucket(uint8_t slot)
+{
+    // the 1% longest are what is left above the bucket
+    uint32_t above = getCount(slot) / 100;
+    uint8_t bucket = PROFILE_BUCKETS - 1;
+    uint32_t sum = _slots[slot].buckets[bucket];
+    while (bucket > 0 && sum <= above) {
+        bucket--;
+        sum += _slots[slot].buckets[bucket];
+    }
+    return bucket;
+}
+
+uint32_t Profiler::getBucketBound(uint8_t bucket)
+{
+    if (bucket >= PROFILE_BUCKETS - 1) {
+        return 0;
+    }
+    return (uint32_t) PROFILE_FIRST_BOUND_MICROS << (2 * bucket);
+}
+
+PGM_P Profiler::getName(uint8_t slot)
+{
+    PGM_P name;
+    memcpy_P(&name, &names[slot], sizeof(name));
+    return name;
+}
+
+void Profiler::onOverflow()
+{
+    _overflows++;
+}
+
+#endif
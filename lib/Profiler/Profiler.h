@@ -0,0 +1,111 @@
+/*
+ * Profiler.h - Library for timing the hot paths, built in with -DPROFILING.
+ * Released into the public domain.
+ */
+
+#ifndef Profiler_h
+#define Profiler_h
+
+#include "Arduino.h"
+
+// what is timed, each with its own histogram
+enum profile_slot_t {
+    PROFILE_LOOP,       // a whole loop() pass
+    PROFILE_LCD,        // LcdManager::loop()
+    PROFILE_BUTTONS,    // a button event, with whatever it sets off
+    PROFILE_REALTIME,   // realtimeLoop()
+    PROFILE_MESSAGES,   // a message handler
+    PROFILE_POUR,       // a pourTask() step
+    PROFILE_FIT,        // CurveFitter::fitPoints()
+    PROFILE_ESTIMATE,   // CurveFitter::estimate()
+    PROFILE_SLOT_COUNT
+};
+
+// bucket i counts durations under 16 us << 2i, the last one the rest
+#define PROFILE_BUCKETS 8
+#define PROFILE_FIRST_BOUND_MICROS 16
+
+// timer 2 with the /32 prescaler, and the 24 bits now() counts in
+#define PROFILE_MICROS_PER_TICK 2
+#define PROFILE_TICK_MASK 0xFFFFFFUL
+
+#ifdef PROFILING
+
+/*
+ * Times sections of code with timer 2, which nothing else here uses:
+ * its count and an overflow interrupt every 512 us make a 2 us clock
+ * that reads in a few cycles, and wraps after 33 s. Each slot keeps a
+ * histogram of fixed buckets and its longest time; when a bucket fills
+ * up they are all halved, so the shape, and the p99 from it, stay.
+ *
+ * Without PROFILING none of this exists and PROFILE() is empty.
+ */
+class Profiler
+{
+    public:
+        Profiler();
+
+        // takes timer 2 over, from the core's PWM on pins 3 and 11
+        void begin();
+
+        // in ticks, see PROFILE_TICK_MASK for the difference of two
+        uint32_t now();
+        void record(uint8_t slot, uint32_t ticks);
+
+        // times recorded since the buckets were last halved
+        uint32_t getCount(uint8_t slot);
+        uint32_t getMaxMicros(uint8_t slot);
+        const uint16_t *getBuckets(uint8_t slot);
+
+        // the bucket 99% of the times fall within
+        uint8_t getP99Bucket(uint8_t slot);
+
+        // upper bound of a bucket, 0 for the last one
+        static uint32_t getBucketBound(uint8_t bucket);
+
+        // in flash
+        static PGM_P getName(uint8_t slot);
+
+        // call from TIMER2_OVF_vect
+        void onOverflow();
+
+    private:
+        struct {
+            uint16_t buckets[PROFILE_BUCKETS];
+            uint32_t maxTicks;
+        } _slots[PROFILE_SLOT_COUNT];
+
+        volatile uint16_t _overflows;
+};
+
+extern Profiler Profile;
+
+// times the rest of the block it is declared in
+class ProfileScope
+{
+    public:
+        ProfileScope(uint8_t slot)
+        {
+            _slot = slot;
+            _start = Profile.now();
+        }
+
+        ~ProfileScope()
+        {
+            Profile.record(_slot, (Profile.now() - _start) & PROFILE_TICK_MASK);
+        }
+
+    private:
+        uint8_t _slot;
+        uint32_t _start;
+};
+
+#define PROFILE(slot) ProfileScope profileScope(slot)
+
+#else
+
+#define PROFILE(slot)
+
+#endif
+
+#endif
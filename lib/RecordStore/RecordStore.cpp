@@ -0,0 +1,188 @@
+/*
+ * RecordStore.cpp - Library for keeping a record in EEPROM across resets.
+ * Released into the public domain.
+ */
+
+#include "RecordStore.h"
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+
+RecordStore::RecordStore(uint16_t start, uint8_t slotCount, uint16_t slotSize, uint8_t version)
+{
+    _start = start;
+    _slotCount = slotCount;
+    _slotSize = slotSize;
+    _version = version;
+    _newestSlot = -1;
+    _writePayload = NULL;
+}
+
+void RecordStore::begin()
+{
+    _newestSlot = -1;
+
+    record_header_t header;
+    for (uint8_t slot = 0; slot < _slotCount; slot++) {
+        if (false == readValidHeader(slot, &header)) {
+            continue;
+        }
+
+        // sequence numbers wrap, newer is less than half the range ahead
+        if (_newestSlot < 0 ||
+            (int16_t) (header.sequence - _newest.sequence) > 0) {
+            _newestSlot = slot;
+            _newest = header;
+        }
+    }
+}
+
+bool RecordStore::hasRecord()
+{
+    return _newestSlot >= 0;
+}
+
+uint16_t RecordStore::getLength()
+{
+    return hasRecord() ? _newest.length : 0;
+}
+
+uint16_t RecordStore::getMaxLength()
+{
+    return _slotSize - sizeof(record_header_t);
+}
+
+bool RecordStore::read(void *payload, uint16_t maxLength)
+{
+    if (false == hasRecord()) {
+        return false;
+    }
+
+    uint16_t length = _newest.length < maxLength ? _newest.length : maxLength;
+    eeprom_read_block(payload, slotAddress(_newestSlot) + sizeof(record_header_t), length);
+    return true;
+}
+
+bool RecordStore::write(const void *payload, uint16_t length)
+{
+    if (false == beginWrite(payload, length)) {
+        return false;
+    }
+    if (false == isWriting()) {
+        return true;
+    }
+
+    uint16_t sequence = _writeHeader.sequence;
+    do {
+        eeprom_busy_wait();
+    } while (writeSome());
+
+    return hasRecord() && _newest.sequence == sequence;
+}
+
+bool RecordStore::beginWrite(const void *payload, uint16_t length)
+{
+    if (length > getMaxLength()) {
+        return false;
+    }
+    _writePayload = NULL;
+
+    // padding too, it is written with the rest
+    record_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.version = _version;
+    header.sequence = hasRecord() ? _newest.sequence + 1 : 0;
+    header.length = length;
+    header.crc = headerCrc(&header);
+    for (uint16_t i = 0; i < length; i++) {
+        header.crc = _crc16_update(header.crc, ((const uint8_t *) payload)[i]);
+    }
+
+    // reading is free, writing wears the cells
+    if (hasRecord() && _newest.length == length) {
+        const uint8_t *stored = slotAddress(_newestSlot) + sizeof(record_header_t);
+        uint16_t i = 0;
+        while (i < length && eeprom_read_byte(stored + i) == ((const uint8_t *) payload)[i]) {
+            i++;
+        }
+        if (i == length) {
+            return true;
+        }
+    }
+
+    _writePayload = (const uint8_t *) payload;
+    _writeHeader = header;
+    _writeSlot = hasRecord() ? (_newestSlot + 1) % _slotCount : 0;
+    _writeOffset = 0;
+    return true;
+}
+
+bool RecordStore::isWriting()
+{
+    return _writePayload != NULL;
+}
+
+bool RecordStore::writeSome()
+{
+    uint16_t length = _writeHeader.length;
+    uint8_t *address = slotAddress(_writeSlot);
+
+    // bytes that are already right take no time, the others one at a time
+    while (isWriting() && eeprom_is_ready()) {
+        if (_writeOffset < length) {
+            eeprom_update_byte(address + sizeof(record_header_t) + _writeOffset,
+                _writePayload[_writeOffset]);
+            _writeOffset++;
+            continue;
+        }
+        if (_writeOffset < length + sizeof(record_header_t)) {
+            eeprom_update_byte(address + _writeOffset - length,
+                ((const uint8_t *) &_writeHeader)[_writeOffset - length]);
+            _writeOffset++;
+            continue;
+        }
+
+        // the previous record stays if it did not read back right
+        _writePayload = NULL;
+        record_header_t written;
+        if (readValidHeader(_writeSlot, &written) && written.sequence == _writeHeader.sequence) {
+            _newestSlot = _writeSlot;
+            _newest = _writeHeader;
+        }
+    }
+
+    return isWriting();
+}
+
+uint8_t *RecordStore::slotAddress(uint8_t slot)
+{
+    return (uint8_t *) (uintptr_t) (_start + slot * _slotSize);
+}
+
+// field by field, so that padding never gets in
+uint16_t RecordStore::headerCrc(const record_header_t *header)
+{
+    uint16_t crc = 0xFFFF;
+    crc = _crc16_update(crc, header->version);
+    crc = _crc16_update(crc, header->sequence & 0xFF);
+    crc = _crc16_update(crc, header->sequence >> 8);
+    crc = _crc16_update(crc, header->length & 0xFF);
+    crc = _crc16_update(crc, header->length >> 8);
+    return crc;
+}
+
+bool RecordStore::readValidHeader(uint8_t slot, record_header_t *header)
+{
+    uint8_t *address = slotAddress(slot);
+    eeprom_read_block(header, address, sizeof(record_header_t));
+
+    if (header->version != _version || header->length > getMaxLength()) {
+        return false;
+    }
+
+    uint16_t crc = headerCrc(header);
+    address += sizeof(record_header_t);
+    for (uint16_t i = 0; i < header->length; i++) {
+        crc = _crc16_update(crc, eeprom_read_byte(address + i));
+    }
+    return crc == header->crc;
+}
@@ -0,0 +1,86 @@
+/*
+ * RecordStore.h - Library for keeping a record in EEPROM across resets.
+ * Released into the public domain.
+ */
+
+#ifndef RecordStore_h
+#define RecordStore_h
+
+#include "Arduino.h"
+
+/*
+ * Precedes the payload in each slot. The CRC covers the rest of the
+ * header and the payload, so a slot torn by a reset mid-write is just
+ * not valid and the previous one is used.
+ */
+typedef struct {
+    uint8_t version;
+    uint16_t sequence;
+    uint16_t length;
+    uint16_t crc;
+} record_header_t;
+
+/*
+ * A region of EEPROM split in slotCount slots of slotSize bytes, header
+ * included. Each write() goes to the slot after the newest one, so the
+ * wear is spread over all of them, and the newest valid slot with the
+ * given version is the record. Writes that would store what is already
+ * there are skipped, and only bytes that differ are written.
+ *
+ * A byte takes ~3.4 ms to write, so beginWrite() only sets a write up,
+ * and writeSome() then does what it can while the EEPROM is ready:
+ * call it every loop() until it returns false. The header goes last,
+ * and until it is complete the previous record stays the newest.
+ */
+class RecordStore
+{
+    public:
+        RecordStore(uint16_t start, uint8_t slotCount, uint16_t slotSize, uint8_t version);
+
+        // finds the newest valid record, reading each slot once
+        void begin();
+
+        bool hasRecord();
+        uint16_t getLength();
+        uint16_t getMaxLength();
+
+        // reads up to maxLength bytes of the record, false if none
+        bool read(void *payload, uint16_t maxLength);
+
+        // false if too long or if it did not read back right; waits
+        bool write(const void *payload, uint16_t length);
+
+        /*
+         * False if too long. payload is read as it is written and must
+         * stay as it is until isWriting() is false. A write still going
+         * on is started over with the new payload.
+         */
+        bool beginWrite(const void *payload, uint16_t length);
+        bool isWriting();
+
+        // never waits for the EEPROM; false once the write is done
+        bool writeSome();
+
+    private:
+        uint8_t *slotAddress(uint8_t slot);
+        uint16_t headerCrc(const record_header_t *header);
+        bool readValidHeader(uint8_t slot, record_header_t *header);
+
+        uint16_t _start;
+        uint8_t _slotCount;
+        uint16_t _slotSize;
+        uint8_t _version;
+
+        // -1 if there is no record yet
+        int8_t _newestSlot;
+        record_header_t _newest;
+
+        // the write going on, NULL payload if none; _writeOffset runs
+        // through the payload, then the header
+        const uint8_t *_writePayload;
+        record_header_t _writeHeader;
+        uint8_t _writeSlot;
+        uint16_t _writeOffset;
+};
+
+#endif
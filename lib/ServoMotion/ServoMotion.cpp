@@ -0,0 +1,140 @@
+/*
+ * ServoMotion.cpp - Library for moving a hobby servo along a velocity profile.
+ * Released into the public domain.
+ */
+
+#include "ServoMotion.h"
+#include "Arduino.h"
+
+ServoMotion::ServoMotion(Servo *servo, uint8_t pin)
+{
+    _servo = servo;
+    _pin = pin;
+
+    _speed = 90;
+    _acceleration = 360;
+
+    _position = 0;
+    _velocity = 0;
+    _target = 0;
+
+    _lastUpdateMillis = 0;
+    _settledMillis = 0;
+    _moving = false;
+}
+
+void ServoMotion::begin(int position)
+{
+    _position = position;
+    _velocity = 0;
+    _target = position;
+    _moving = false;
+
+    // written first, so that attaching does not jump to the default pulse
+    write();
+    if (!_servo->attached()) {
+        _servo->attach(_pin);
+    }
+    _settledMillis = millis();
+}
+
+void ServoMotion::setProfile(double speed, double acceleration)
+{
+    _speed = speed;
+    _acceleration = acceleration;
+}
+
+void ServoMotion::moveTo(int target)
+{
+    _target = target;
+
+    if (!_moving) {
+        _lastUpdateMillis = millis();
+        _moving = true;
+    }
+
+    if (!_servo->attached()) {
+        write();
+        _servo->attach(_pin);
+    }
+}
+
+/*
+ * Speeds up towards the target until the distance left is what it takes
+ * to stop at the set acceleration, then slows down. Going the wrong way,
+ * after a new target, it slows down and turns around.
+ */
+uint32_t ServoMotion::update()
+{
+    unsigned long now = millis();
+
+    if (!_moving) {
+        if (!_servo->attached()) {
+            return SERVO_MOTION_IDLE;
+        }
+        if (now - _settledMillis < SERVO_MOTION_SETTLE_MILLIS) {
+            return SERVO_MOTION_SETTLE_MILLIS - (now - _settledMillis);
+        }
+        _servo->detach();
+        return SERVO_MOTION_IDLE;
+    }
+
+    double dt = (now - _lastUpdateMillis) / 1000.0;
+    _lastUpdateMillis = now;
+
+    double distance = _target - _position;
+    double direction = distance >= 0 ? 1 : -1;
+    double speedToTarget = _velocity * direction;
+    double newSpeed;
+
+    if (speedToTarget > 0 &&
+        fabs(distance) <= speedToTarget * speedToTarget / (2 * _acceleration)) {
+        newSpeed = speedToTarget - _acceleration * dt;
+    }
+    else {
+        newSpeed = speedToTarget + _acceleration * dt;
+        if (newSpeed > _speed) {
+            newSpeed = _speed;
+        }
+    }
+
+    double travel = (speedToTarget + newSpeed) / 2 * dt;
+    if (travel >= fabs(distance)) {
+        _position = _target;
+        _velocity = 0;
+        _moving = false;
+        _settledMillis = now;
+        write();
+        return SERVO_MOTION_SETTLE_MILLIS;
+    }
+
+    _position += travel * direction;
+    _velocity = newSpeed * direction;
+    write();
+    return SERVO_MOTION_STEP_MILLIS;
+}
+
+bool ServoMotion::isMoving()
+{
+    return _moving;
+}
+
+bool ServoMotion::isAttached()
+{
+    return _servo->attached();
+}
+
+int ServoMotion::getPosition()
+{
+    return (int) floor(_position + 0.5);
+}
+
+int ServoMotion::getTarget()
+{
+    return _target;
+}
+
+void ServoMotion::write()
+{
+    _servo->write(getPosition());
+}
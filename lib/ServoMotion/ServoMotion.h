@@ -0,0 +1,74 @@
+/*
+ * ServoMotion.h - Library for moving a hobby servo along a velocity profile.
+ * Released into the public domain.
+ */
+
+#ifndef ServoMotion_h
+#define ServoMotion_h
+
+#include "Arduino.h"
+#include <Servo.h>
+
+// a servo takes a new position once per 20 ms pulse anyway
+#ifndef SERVO_MOTION_STEP_MILLIS
+#define SERVO_MOTION_STEP_MILLIS 20
+#endif
+
+// time the servo is left powered at the target before it is detached
+#ifndef SERVO_MOTION_SETTLE_MILLIS
+#define SERVO_MOTION_SETTLE_MILLIS 300
+#endif
+
+// returned by update() once there is nothing left to do
+#define SERVO_MOTION_IDLE 0xFFFFFFFFUL
+
+/*
+ * Moves the servo to a target angle with a trapezoidal velocity profile:
+ * it accelerates up to the set speed, cruises, and slows down so as to
+ * stop at the target. A new target can be given at any time, the
+ * motion carries on from where the servo is and how fast it is going.
+ *
+ * The servo is attached for a move and detached once it has settled at
+ * the target, so that it does not draw current and jitter while idle.
+ * Call update() every getNextUpdateMillis(), typically from a task.
+ */
+class ServoMotion
+{
+    public:
+        ServoMotion(Servo *servo, uint8_t pin);
+
+        // jumps to position, which is where the servo is taken to be
+        void begin(int position);
+
+        // degrees per second and degrees per second squared
+        void setProfile(double speed, double acceleration);
+        void moveTo(int target);
+
+        // milliseconds until it wants to be updated again, or SERVO_MOTION_IDLE
+        uint32_t update();
+
+        bool isMoving();
+        bool isAttached();
+        int getPosition();
+        int getTarget();
+
+    private:
+        void write();
+
+        Servo *_servo;
+        uint8_t _pin;
+
+        double _speed;
+        double _acceleration;
+
+        // degrees and degrees per second, signed
+        double _position;
+        double _velocity;
+        int _target;
+
+        unsigned long _lastUpdateMillis;
+        unsigned long _settledMillis;
+        bool _moving;
+};
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ * TaskScheduler.cpp - Library for running cooperative tasks without delay().
+ * Released into the public domain.
+ */
+
+#include "TaskScheduler.h"
+#include "Arduino.h"
+
+TaskScheduler::TaskScheduler()
+{
+    _size = 0;
+}
+
+bool TaskScheduler::schedule(task_t task, void *context, uint32_t delayMillis)
+{
+    int index = find(task, context);
+    if (index >= 0) {
+        remove(index);
+    }
+    else if (_size == TASK_SCHEDULER_CAPACITY) {
+        return false;
+    }
+
+    uint32_t due = (uint32_t) millis() + delayMillis;
+
+    /*
+     * Insertion sort on the due time. The difference of two due times is
+     * compared as a signed number so that the order survives the millis()
+     * rollover every ~49 days.
+     */
+    int i = _size;
+    while (i > 0 && (int32_t) (_tasks[i-1].due - due) > 0) {
+        _tasks[i] = _tasks[i-1];
+        i--;
+    }
+
+    _tasks[i].task = task;
+    _tasks[i].context = context;
+    _tasks[i].due = due;
+    _size++;
+
+    return true;
+}
+
+void TaskScheduler::cancel(task_t task, void *context)
+{
+    int index = find(task, context);
+    if (index >= 0) {
+        remove(index);
+    }
+}
+
+bool TaskScheduler::isScheduled(task_t task, void *context)
+{
+    return find(task, context) >= 0;
+}
+
+void TaskScheduler::run()
+{
+    uint32_t now = (uint32_t) millis();
+
+    // each task runs at most once per call, even if it asks for 0 ms
+    for (uint8_t n = _size; n > 0 && _size > 0; n--) {
+        if ((int32_t) (_tasks[0].due - now) > 0) {
+            break;
+        }
+
+        task_t task = _tasks[0].task;
+        void *context = _tasks[0].context;
+        remove(0);
+
+        uint32_t next = task(context);
+        if (next != TASK_DONE) {
+            schedule(task, context, next);
+        }
+    }
+}
+
+int TaskScheduler::find(task_t task, void *context)
+{
+    for (int i = 0; i < _size; i++) {
+        if (_tasks[i].task == task && _tasks[i].context == context) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void TaskScheduler::remove(int index)
+{
+    _size--;
+    for (int i = index; i < _size; i++) {
+        _tasks[i] = _tasks[i+1];
+    }
+}
@@ -0,0 +1,52 @@
+/*
+ * TaskScheduler.h - Library for running cooperative tasks without delay().
+ * Released into the public domain.
+ */
+
+#ifndef TaskScheduler_h
+#define TaskScheduler_h
+
+#include "Arduino.h"
+
+#ifndef TASK_SCHEDULER_CAPACITY
+#define TASK_SCHEDULER_CAPACITY 8
+#endif
+
+// returned by a task that does not want to run again
+#define TASK_DONE 0xFFFFFFFFUL
+
+/*
+ * A task does a short slice of work and returns how many milliseconds
+ * from now it wants to run again, or TASK_DONE. Tasks keep their own
+ * state between calls, typically as a small state machine.
+ */
+typedef uint32_t (*task_t)(void *context);
+
+class TaskScheduler
+{
+    public:
+        TaskScheduler();
+
+        // (re)schedules task/context to run delayMillis from now
+        bool schedule(task_t task, void *context, uint32_t delayMillis);
+        void cancel(task_t task, void *context);
+        bool isScheduled(task_t task, void *context);
+
+        // runs every task that is due; call it from loop()
+        void run();
+
+    private:
+        int find(task_t task, void *context);
+        void remove(int index);
+
+        // kept sorted by due time, earliest first
+        struct {
+            task_t task;
+            void *context;
+            uint32_t due;
+        } _tasks[TASK_SCHEDULER_CAPACITY];
+
+        uint8_t _size;
+};
+
+#endif
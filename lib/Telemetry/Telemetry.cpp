@@ -0,0 +1,109 @@
+/*
+ * Telemetry.cpp - Library for streaming records out as framed binary.
+ * Released into the public domain.
+ */
+
+#include "Telemetry.h"
+#include "Arduino.h"
+#include <util/crc16.h>
+
+Telemetry::Telemetry(void *storage, uint8_t recordSize, uint8_t capacity)
+{
+    _storage = (uint8_t *) storage;
+    _recordSize = recordSize;
+    _capacity = capacity;
+    _head = 0;
+    _count = 0;
+    _sequence = 0;
+}
+
+/*
+ * A slot is the record length, then the frame as it is before COBS:
+ * sequence, type, record, and room for the CRC, added by send().
+ */
+void Telemetry::push(uint8_t type, const void *record, uint8_t length)
+{
+    if (length > _recordSize) {
+        length = _recordSize;
+    }
+
+    uint8_t tail = _head + _count;
+    if (tail >= _capacity) {
+        tail -= _capacity;
+    }
+
+    uint8_t *p = slot(tail);
+    p[0] = length;
+    p[1] = _sequence & 0xFF;
+    p[2] = _sequence >> 8;
+    p[3] = type;
+    memcpy(p + 4, record, length);
+
+    if (_count < _capacity) {
+        _count++;
+    }
+    else if (++_head == _capacity) {
+        _head = 0;
+    }
+    _sequence++;
+}
+
+/*
+ * out->availableForWrite() said the whole frame fits, so none of the
+ * writes below wait for the line.
+ */
+bool Telemetry::send(Print *out)
+{
+    if (_count == 0) {
+        return false;
+    }
+
+    uint8_t *p = slot(_head);
+    uint8_t length = p[0];
+    if (out->availableForWrite() < TELEMETRY_FRAME_SIZE(length)) {
+        return false;
+    }
+
+    uint8_t *raw = p + 1;
+    uint8_t rawLength = 3 + length;
+
+    uint16_t crc = 0;
+    for (uint8_t i = 0; i < rawLength; i++) {
+        crc = _crc16_update(crc, raw[i]);
+    }
+    raw[rawLength++] = crc & 0xFF;
+    raw[rawLength++] = crc >> 8;
+
+    // each run of non-zero bytes goes out after its length plus one,
+    // which stands for the zero that ended it
+    uint8_t start = 0;
+    while (true) {
+        uint8_t end = start;
+        while (end < rawLength && raw[end] != 0) {
+            end++;
+        }
+        out->write((uint8_t) (end - start + 1));
+        out->write(raw + start, end - start);
+        if (end == rawLength) {
+            break;
+        }
+        start = end + 1;
+    }
+    out->write((uint8_t) 0);
+
+    if (++_head == _capacity) {
+        _head = 0;
+    }
+    _count--;
+    return true;
+}
+
+bool Telemetry::isEmpty()
+{
+    return _count == 0;
+}
+
+uint8_t *Telemetry::slot(uint8_t index)
+{
+    return _storage + index * TELEMETRY_SLOT_SIZE(_recordSize);
+}
@@ -0,0 +1,65 @@
+/*
+ * Telemetry.h - Library for streaming records out as framed binary.
+ * Released into the public domain.
+ */
+
+#ifndef Telemetry_h
+#define Telemetry_h
+
+#include "Arduino.h"
+
+// bytes a record takes in the storage given to Telemetry, see push()
+#define TELEMETRY_SLOT_SIZE(recordSize) ((recordSize) + 6)
+
+// sequence, type, record and CRC, COBS overhead and the delimiter
+#define TELEMETRY_FRAME_SIZE(recordSize) ((recordSize) + 7)
+
+// so that a frame needs a single COBS code byte
+#define TELEMETRY_MAX_RECORD_SIZE 249
+
+/*
+ * Keeps the last few records in a ring in RAM and sends them, oldest
+ * first, when there is room for them in the output buffer, so neither
+ * side ever waits for the other. push() is just a copy: it is the only
+ * part meant to run where time matters.
+ *
+ * Each record goes out as one frame:
+ *
+ *   COBS(sequence:2 type:1 record:length crc:2) 0x00
+ *
+ * little endian, with the CRC-16 of util/crc16.h over what precedes it.
+ * COBS leaves no zero byte in the frame, so a reader can pick up at the
+ * next 0x00 whenever it starts or loses a byte. The sequence counts
+ * every record pushed: a gap in it is records the ring overwrote
+ * before they could be sent.
+ */
+class Telemetry
+{
+    public:
+        // storage holds capacity slots of TELEMETRY_SLOT_SIZE(recordSize) bytes,
+        // recordSize at most TELEMETRY_MAX_RECORD_SIZE
+        Telemetry(void *storage, uint8_t recordSize, uint8_t capacity);
+
+        // over the oldest record if the ring is full; length <= recordSize
+        void push(uint8_t type, const void *record, uint8_t length);
+
+        // sends the oldest record if out has room for all of it
+        bool send(Print *out);
+
+        bool isEmpty();
+
+    private:
+        uint8_t *slot(uint8_t index);
+
+        uint8_t *_storage;
+        uint8_t _recordSize;
+        uint8_t _capacity;
+
+        uint8_t _head;
+        uint8_t _count;
+
+        // of the next record pushed
+        uint16_t _sequence;
+};
+
+#endif
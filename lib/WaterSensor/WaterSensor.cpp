@@ -0,0 +1,161 @@
+/*
+ * WaterSensor.cpp - Library for timing the straw sensor with a pin change interrupt.
+ * Released into the public domain.
+ */
+
+#include "WaterSensor.h"
+#include "Arduino.h"
+
+// stops the compiler from moving buffer accesses across the index updates
+#define MEMORY_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+
+WaterSensor::WaterSensor(uint8_t pin)
+{
+    _pin = pin;
+    _flowing = false;
+    _head = 0;
+    _tail = 0;
+    _dropped = 0;
+    _armMicros = 0;
+    _flowMicros = 0;
+    _hasFlowed = false;
+    _wetMicros = 0;
+    _wetSinceMicros = 0;
+    _wet = false;
+    _gaps = 0;
+}
+
+void WaterSensor::begin()
+{
+    pinMode(_pin, INPUT);
+
+    _inputRegister = portInputRegister(digitalPinToPort(_pin));
+    _bitMask = digitalPinToBitMask(_pin);
+    _flowing = (*_inputRegister & _bitMask) == 0;
+
+    *digitalPinToPCMSK(_pin) |= (1 << digitalPinToPCMSKbit(_pin));
+    *digitalPinToPCICR(_pin) |= (1 << digitalPinToPCICRbit(_pin));
+}
+
+void WaterSensor::onPinChange()
+{
+    bool flowing = (*_inputRegister & _bitMask) == 0;
+
+    // other pins of the same port may have triggered the interrupt
+    if (flowing == _flowing) {
+        return;
+    }
+    _flowing = flowing;
+
+    uint8_t next = (_head + 1) & (WATER_SENSOR_BUFFER_SIZE - 1);
+    if (next == _tail) {
+        _dropped++;
+        return;
+    }
+
+    _edges[_head].micros = micros();
+    _edges[_head].flowing = flowing;
+    MEMORY_BARRIER();
+    _head = next;
+}
+
+bool WaterSensor::isFlowing()
+{
+    return _flowing;
+}
+
+bool WaterSensor::readEdge(water_edge_t *edge)
+{
+    if (_tail == _head) {
+        return false;
+    }
+
+    MEMORY_BARRIER();
+    *edge = _edges[_tail];
+    MEMORY_BARRIER();
+    _tail = (_tail + 1) & (WATER_SENSOR_BUFFER_SIZE - 1);
+
+    return true;
+}
+
+uint8_t WaterSensor::getDroppedEdges()
+{
+    return _dropped;
+}
+
+void WaterSensor::arm()
+{
+    // edges from before the straw went down do not count
+    water_edge_t edge;
+    while (readEdge(&edge)) {
+    }
+
+    _armMicros = micros();
+    _hasFlowed = _flowing;
+    _flowMicros = _armMicros;
+
+    _wetMicros = 0;
+    _wetSinceMicros = _armMicros;
+    _wet = _flowing;
+    _gaps = 0;
+}
+
+bool WaterSensor::hasFlowed()
+{
+    readEdges();
+    return _hasFlowed;
+}
+
+void WaterSensor::readEdges()
+{
+    water_edge_t edge;
+    while (readEdge(&edge)) {
+        if ((int32_t) (edge.micros - _armMicros) < 0 || edge.flowing == _wet) {
+            continue;
+        }
+
+        if (edge.flowing) {
+            if (_hasFlowed) {
+                _gaps++;
+            }
+            else {
+                _hasFlowed = true;
+                _flowMicros = edge.micros;
+            }
+            _wetSinceMicros = edge.micros;
+        }
+        else {
+            _wetMicros += edge.micros - _wetSinceMicros;
+        }
+        _wet = edge.flowing;
+    }
+}
+
+uint32_t WaterSensor::getWetMicros()
+{
+    readEdges();
+    if (_wet) {
+        return _wetMicros + (micros() - _wetSinceMicros);
+    }
+    return _wetMicros;
+}
+
+uint32_t WaterSensor::getDryMicros()
+{
+    uint32_t wet = getWetMicros();
+    if (!_hasFlowed) {
+        return 0;
+    }
+    return (micros() - _flowMicros) - wet;
+}
+
+uint8_t WaterSensor::getGapCount()
+{
+    readEdges();
+    return _gaps;
+}
+
+uint32_t WaterSensor::getTimeToFlowMicros()
+{
+    return _flowMicros - _armMicros;
+}
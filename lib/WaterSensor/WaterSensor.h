@@ -0,0 +1,89 @@
+/*
+ * WaterSensor.h - Library for timing the straw sensor with a pin change interrupt.
+ * Released into the public domain.
+ */
+
+#ifndef WaterSensor_h
+#define WaterSensor_h
+
+#include "Arduino.h"
+
+// must be a power of two, at most 128
+#ifndef WATER_SENSOR_BUFFER_SIZE
+#define WATER_SENSOR_BUFFER_SIZE 8
+#endif
+
+struct water_edge_t {
+    uint32_t micros;
+    bool flowing;
+};
+
+/*
+ * The sensor pulls its pin LOW while water is passing. Every change of the
+ * pin is captured from the pin change interrupt with a micros() timestamp
+ * and queued in a ring buffer: the interrupt is the only producer and the
+ * main loop the only consumer, so no locking is needed.
+ */
+class WaterSensor
+{
+    public:
+        WaterSensor(uint8_t pin);
+
+        // configures the pin and enables its pin change interrupt
+        void begin();
+
+        // call from the ISR of the pin change group the pin belongs to
+        void onPinChange();
+
+        bool isFlowing();
+
+        // pops the oldest captured edge, false if there is none
+        bool readEdge(water_edge_t *edge);
+
+        // number of edges lost because the buffer was full
+        uint8_t getDroppedEdges();
+
+        /*
+         * Times the water reaching the sensor: arm() when the straw goes
+         * down, then poll hasFlowed(). getTimeToFlowMicros() is exact to
+         * the interrupt latency, however rarely hasFlowed() is polled.
+         */
+        void arm();
+        bool hasFlowed();
+        uint32_t getTimeToFlowMicros();
+
+        /*
+         * Since the water first reached the sensor: how long it has been
+         * wet, how long dry, and how many times it came back after
+         * running dry, which is what an air gap in the straw looks like.
+         */
+        uint32_t getWetMicros();
+        uint32_t getDryMicros();
+        uint8_t getGapCount();
+
+    private:
+        uint8_t _pin;
+        volatile uint8_t *_inputRegister;
+        uint8_t _bitMask;
+
+        volatile bool _flowing;
+
+        water_edge_t _edges[WATER_SENSOR_BUFFER_SIZE];
+        volatile uint8_t _head; // written by the interrupt only
+        volatile uint8_t _tail; // written by readEdge() only
+        volatile uint8_t _dropped;
+
+        void readEdges();
+
+        uint32_t _armMicros;
+        uint32_t _flowMicros;
+        bool _hasFlowed;
+
+        // wet time up to _wetSinceMicros, when it last became wet if _wet
+        uint32_t _wetMicros;
+        uint32_t _wetSinceMicros;
+        bool _wet;
+        uint8_t _gaps;
+};
+
+#endif
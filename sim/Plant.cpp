@@ -0,0 +1,124 @@
+/*
+ * Plant.cpp - Physical model of the reservoir, straw and water sensor.
+ * Released into the public domain.
+ */
+
+#include "Plant.h"
+
+// below this fraction the straw sucks air only
+#define PLANT_EMPTY_FRACTION 0.03
+
+Plant::Plant()
+{
+    unitMl = 25;
+    pouredMl = 0;
+    pourStartMl = 0;
+    pourStartMicros = 0;
+    pourTimeToStrawMillis = 0;
+
+    _capacityMl = 1500;
+    _levelMl = _capacityMl;
+    _strawDown = false;
+    _flowing = false;
+    _arrivalMicros = PLANT_NO_EVENT;
+}
+
+void Plant::setLevel(double fraction)
+{
+    if (fraction < 0) {
+        fraction = 0;
+    }
+    if (fraction > 1) {
+        fraction = 1;
+    }
+    _levelMl = fraction * _capacityMl;
+}
+
+double Plant::getLevel()
+{
+    return _levelMl / _capacityMl;
+}
+
+double Plant::timeToStrawMillis()
+{
+    return 600 + 2400 * (1 - getLevel());
+}
+
+double Plant::flowMlPerSecond()
+{
+    return 4 + 16 * getLevel();
+}
+
+void Plant::strawDown(uint64_t now)
+{
+    _strawDown = true;
+    pourStartMicros = now;
+    pourStartMl = pouredMl;
+    pourTimeToStrawMillis = timeToStrawMillis();
+
+    if (getLevel() < PLANT_EMPTY_FRACTION) {
+        _arrivalMicros = PLANT_NO_EVENT;
+    }
+    else {
+        _arrivalMicros = now + (uint64_t) (pourTimeToStrawMillis * 1000);
+    }
+}
+
+void Plant::strawUp(uint64_t now)
+{
+    (void) now;
+    _strawDown = false;
+    _flowing = false;
+    _arrivalMicros = PLANT_NO_EVENT;
+}
+
+void Plant::airGap(uint64_t now, uint64_t duration)
+{
+    if (!_flowing) {
+        return;
+    }
+    _flowing = false;
+    _arrivalMicros = now + duration;
+}
+
+bool Plant::isStrawDown()
+{
+    return _strawDown;
+}
+
+bool Plant::isFlowing()
+{
+    return _flowing;
+}
+
+uint64_t Plant::nextEvent()
+{
+    return _flowing ? PLANT_NO_EVENT : _arrivalMicros;
+}
+
+void Plant::step(uint64_t from, uint64_t to)
+{
+    if (!_strawDown) {
+        return;
+    }
+
+    if (!_flowing) {
+        if (_arrivalMicros == PLANT_NO_EVENT || to < _arrivalMicros) {
+            return;
+        }
+        _flowing = true;
+        from = _arrivalMicros;
+    }
+
+    double ml = flowMlPerSecond() * (double) (to - from) / 1e6;
+    if (ml > _levelMl) {
+        ml = _levelMl;
+    }
+    _levelMl -= ml;
+    pouredMl += ml;
+
+    if (getLevel() < PLANT_EMPTY_FRACTION) {
+        _flowing = false;
+        _arrivalMicros = PLANT_NO_EVENT;
+    }
+}
@@ -0,0 +1,63 @@
+/*
+ * Plant.h - Physical model of the reservoir, straw and water sensor.
+ * Released into the public domain.
+ *
+ * The reservoir drains as it pours: the lower the level, the longer water
+ * takes to climb up to the straw sensor and the slower it flows once it
+ * does. That is the relation the sketch calibrates with CurveFitting.
+ */
+
+#ifndef Plant_h
+#define Plant_h
+
+#include <stdint.h>
+
+#define PLANT_NO_EVENT UINT64_MAX
+
+class Plant
+{
+    public:
+        Plant();
+
+        void setLevel(double fraction);
+        double getLevel();
+
+        // the straw crossed the water surface
+        void strawDown(uint64_t now);
+        void strawUp(uint64_t now);
+        bool isStrawDown();
+
+        // air in the straw: the flow stops for a while, then comes back
+        void airGap(uint64_t now, uint64_t duration);
+
+        // true while water is passing the straw sensor
+        bool isFlowing();
+
+        // time of the next state change that needs exact timing
+        uint64_t nextEvent();
+
+        // integrates the flow over [from, to)
+        void step(uint64_t from, uint64_t to);
+
+        // water needed to reach the straw at the current level
+        double timeToStrawMillis();
+        double flowMlPerSecond();
+
+        // volume of one unit, as the user filling the glass sees it
+        double unitMl;
+
+        // running totals
+        double pouredMl;
+        double pourStartMl;
+        uint64_t pourStartMicros;
+        double pourTimeToStrawMillis;
+
+    private:
+        double _capacityMl;
+        double _levelMl;
+        bool _strawDown;
+        bool _flowing;
+        uint64_t _arrivalMicros;
+};
+
+#endif
@@ -0,0 +1,813 @@
+/*
+ * Simulator.cpp - Virtual clock and board model for running the sketch on a host.
+ * Released into the public domain.
+ */
+
+#include "Simulator.h"
+#include "stubs/avr/io.h"
+#include "stubs/HardwareSerial.h"
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#define SIM_NONE UINT64_MAX
+
+Simulator Sim;
+
+volatile uint8_t PINB;
+volatile uint8_t PINC;
+volatile uint8_t PIND;
+
+volatile uint8_t PCICR;
+volatile uint8_t PCIFR;
+volatile uint8_t PCMSK0;
+volatile uint8_t PCMSK1;
+volatile uint8_t PCMSK2;
+
+volatile uint8_t TIMSK0;
+volatile uint8_t TIFR0;
+volatile uint8_t OCR0A;
+
+volatile uint8_t TCCR2A;
+volatile uint8_t TCCR2B;
+volatile uint8_t TIMSK2;
+volatile uint8_t TIFR2;
+
+// pin change handlers defined by the sketch, if any
+extern "C" void PCINT0_vect(void) __attribute__((weak));
+extern "C" void PCINT1_vect(void) __attribute__((weak));
+extern "C" void PCINT2_vect(void) __attribute__((weak));
+extern "C" void TIMER0_COMPA_vect(void) __attribute__((weak));
+extern "C" void TIMER2_OVF_vect(void) __attribute__((weak));
+
+Simulator::Simulator()
+{
+    _now = 0;
+    _startOffset = 0;
+    _until = 600 * 1000000ULL;
+    _loopCost = 20;
+    _quiet = false;
+    _eepromPath = NULL;
+    _serialFile = NULL;
+    _freeMemory = SIM_FREE_MEMORY;
+
+    _scriptSize = 0;
+    _scriptNext = 0;
+    _pourButton = 0;
+    _pourUntilMl = 0;
+
+    for (int i = 0; i < SIM_PINS; i++) {
+        _pins[i] = SIM_LOW;
+    }
+    _interruptsEnabled = true;
+    _inInterrupt = false;
+    setPin(SIM_PIN_WATER_SENSOR, SIM_HIGH);
+
+    _servoAttached = false;
+    _servoAngle = 0;
+    _servoTarget = 0;
+
+    memset(_ddram, ' ', sizeof(_ddram));
+    memset(_shownScreen, 0, sizeof(_shownScreen));
+    _lcdLastAccess = 0;
+
+    // a blank ATmega328P EEPROM reads back as 0xFF
+    memset(_eeprom, 0xFF, sizeof(_eeprom));
+    memset(_eepromWrites, 0, sizeof(_eepromWrites));
+    _eepromReadyAt = 0;
+
+    _serialByteTime = 0;
+    _serialIdleAt = 0;
+
+    _loops = 0;
+    _loopStart = SIM_NONE;
+    _loopMaxGap = 0;
+    _responsePending = SIM_NONE;
+    _responses = 0;
+    _responseLatencySum = 0;
+    _responseLatencyMax = 0;
+    _lcdBytes = 0;
+    _lcdClears = 0;
+    _lcdBusTime = 0;
+    _servoAttachedTime = 0;
+    _serialBytes = 0;
+    _serialBlockedTime = 0;
+    _eepromBlockedTime = 0;
+    _pours = 0;
+    _pourSumMl = 0;
+    _pourSumSqMl = 0;
+}
+
+static void usage(FILE *f, const char *name)
+{
+    fprintf(f,
+        "usage: %s [-h] [-q] [-t seconds] [-l loop-cost-us] [-s start-millis]\n"
+        "          [-e eeprom-file] [-S serial-file] [-L level] [-M bytes] [script]\n"
+        "\n"
+        "  -h  print this and exit\n"
+        "  -q  print the final report only\n"
+        "  -t  virtual seconds to run for (default 600)\n"
+        "  -l  modelled cost of one loop() pass besides I/O (default 20)\n"
+        "  -s  millis() value at power-on, to exercise rollover\n"
+        "  -e  EEPROM image, loaded at start and saved at the end\n"
+        "  -S  file to save what the sketch sends over Serial to\n"
+        "  -L  initial reservoir level, 0..1 (default 1)\n"
+        "  -M  free RAM the board reports, in bytes (default 600)\n",
+        name);
+}
+
+bool Simulator::begin(int argc, char **argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "hqt:l:s:e:S:L:M:")) != -1) {
+        switch (opt) {
+            case 'q': _quiet = true;                                      break;
+            case 't': _until = (uint64_t) (atof(optarg) * 1e6);           break;
+            case 'l': _loopCost = strtoull(optarg, NULL, 10);             break;
+            case 's': _startOffset = strtoull(optarg, NULL, 10) * 1000;   break;
+            case 'e': _eepromPath = optarg;                               break;
+            case 'S':
+                _serialFile = fopen(optarg, "wb");
+                if (_serialFile == NULL) {
+                    perror(optarg);
+                    return false;
+                }
+                break;
+            case 'L': _plant.setLevel(atof(optarg));                      break;
+            case 'M': _freeMemory = atoi(optarg);                         break;
+            case 'h':
+                usage(stdout, argv[0]);
+                exit(0);
+            default:
+                usage(stderr, argv[0]);
+                return false;
+        }
+    }
+
+    if (_eepromPath != NULL) {
+        FILE *f = fopen(_eepromPath, "rb");
+        if (f != NULL) {
+            if (fread(_eeprom, 1, sizeof(_eeprom), f) != sizeof(_eeprom)) {
+                fprintf(stderr, "%s: short EEPROM image\n", _eepromPath);
+            }
+            fclose(f);
+        }
+    }
+
+    if (optind < argc && !loadScript(argv[optind])) {
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Script format, one command per line, '#' starts a comment:
+ *
+ *   <seconds> press <button>    hold a button down (1..3)
+ *   <seconds> release <button>
+ *   <seconds> tap <button>      press, release 150 ms later
+ *   <seconds> pour <button>     hold a button until one unit has poured
+ *   <seconds> level <0..1>      set the reservoir level (refill)
+ *   <seconds> gap <ms>          stop the flow for a while, as air in the straw
+ */
+bool Simulator::loadScript(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+
+    char line[128];
+    int lineNo = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        lineNo++;
+
+        char *hash = strchr(line, '#');
+        if (hash != NULL) {
+            *hash = '\0';
+        }
+
+        double seconds, arg;
+        char cmd[16];
+        int fields = sscanf(line, "%lf %15s %lf", &seconds, cmd, &arg);
+        if (fields <= 0) {
+            continue;
+        }
+        if (fields != 3) {
+            fprintf(stderr, "%s:%d: expected <seconds> <command> <arg>\n", path, lineNo);
+            fclose(f);
+            return false;
+        }
+
+        uint64_t at = (uint64_t) (seconds * 1e6);
+        if (strcmp(cmd, "press") == 0) {
+            addEvent(at, SIM_CMD_PRESS, arg);
+        }
+        else if (strcmp(cmd, "release") == 0) {
+            addEvent(at, SIM_CMD_RELEASE, arg);
+        }
+        else if (strcmp(cmd, "tap") == 0) {
+            addEvent(at, SIM_CMD_PRESS, arg);
+            addEvent(at + 150000, SIM_CMD_RELEASE, arg);
+        }
+        else if (strcmp(cmd, "pour") == 0) {
+            addEvent(at, SIM_CMD_POUR, arg);
+        }
+        else if (strcmp(cmd, "level") == 0) {
+            addEvent(at, SIM_CMD_LEVEL, arg);
+        }
+        else if (strcmp(cmd, "gap") == 0) {
+            addEvent(at, SIM_CMD_GAP, arg);
+        }
+        else {
+            fprintf(stderr, "%s:%d: unknown command '%s'\n", path, lineNo, cmd);
+            fclose(f);
+            return false;
+        }
+    }
+
+    fclose(f);
+    return true;
+}
+
+void Simulator::addEvent(uint64_t at, sim_command_t cmd, double arg)
+{
+    if (_scriptSize == SIM_SCRIPT_SIZE) {
+        fprintf(stderr, "script too long, ignoring the tail\n");
+        return;
+    }
+
+    // keep the script sorted; equal times keep their file order
+    int i = _scriptSize++;
+    while (i > 0 && _script[i-1].at > at) {
+        _script[i] = _script[i-1];
+        i--;
+    }
+    _script[i].at = at;
+    _script[i].cmd = cmd;
+    _script[i].arg = arg;
+}
+
+void Simulator::runEvent(int index)
+{
+    int button = (int) _script[index].arg;
+
+    switch (_script[index].cmd) {
+        case SIM_CMD_PRESS:
+            setButton(button, true);
+            break;
+        case SIM_CMD_RELEASE:
+            setButton(button, false);
+            break;
+        case SIM_CMD_POUR:
+            setButton(button, true);
+            _pourButton = button;
+            _pourUntilMl = -1;
+            break;
+        case SIM_CMD_LEVEL:
+            _plant.setLevel(_script[index].arg);
+            trace("LEVEL %.0f%%", _plant.getLevel() * 100);
+            break;
+        case SIM_CMD_GAP:
+            if (_plant.isFlowing()) {
+                _plant.airGap(_now, (uint64_t) (_script[index].arg * 1000));
+                trace("WATER stopped: air gap");
+                setPin(SIM_PIN_WATER_SENSOR, SIM_HIGH);
+            }
+            break;
+    }
+}
+
+void Simulator::setButton(int button, bool pressed)
+{
+    static const uint8_t pins[] = { SIM_PIN_BUTTON1, SIM_PIN_BUTTON2, SIM_PIN_BUTTON3 };
+    if (button < 1 || button > 3) {
+        return;
+    }
+
+    uint8_t pin = pins[button-1];
+    _responsePending = _now;
+    setPin(pin, pressed ? SIM_HIGH : SIM_LOW);
+    trace("BUTTON%d %s", button, pressed ? "down" : "up");
+}
+
+uint64_t Simulator::now()
+{
+    return _now;
+}
+
+uint32_t Simulator::millis32()
+{
+    return (uint32_t) ((_startOffset + _now) / 1000);
+}
+
+uint32_t Simulator::micros32()
+{
+    return (uint32_t) (_startOffset + _now);
+}
+
+void Simulator::advance(uint64_t us)
+{
+    uint64_t end = _now + us;
+
+    for (;;) {
+        while (_scriptNext < _scriptSize && _script[_scriptNext].at <= _now) {
+            runEvent(_scriptNext++);
+        }
+
+        if (_now >= end) {
+            break;
+        }
+
+        uint64_t to = end;
+        if (_scriptNext < _scriptSize && _script[_scriptNext].at < to) {
+            to = _script[_scriptNext].at;
+        }
+
+        uint64_t event = _plant.nextEvent();
+        if (event < to) {
+            to = event > _now ? event : _now + 1;
+        }
+
+        if (TIMSK0 & (1 << OCIE0A)) {
+            uint64_t tick = (_now / SIM_TIMER0_PERIOD + 1) * SIM_TIMER0_PERIOD;
+            if (tick < to) {
+                to = tick;
+            }
+        }
+        if (TIMSK2 & (1 << TOIE2)) {
+            uint64_t overflow = (_now / SIM_TIMER2_PERIOD + 1) * SIM_TIMER2_PERIOD;
+            if (overflow < to) {
+                to = overflow;
+            }
+        }
+
+        // integrate moving parts in 1 ms slices
+        bool moving = _servoAttached && _servoAngle != _servoTarget;
+        if ((moving || _plant.isFlowing()) && to > _now + 1000) {
+            to = _now + 1000;
+        }
+
+        stepDevices(to);
+
+        if ((TIMSK0 & (1 << OCIE0A)) && _now % SIM_TIMER0_PERIOD == 0) {
+            TIFR0 |= (1 << OCF0A);
+            dispatchInterrupts();
+        }
+        if ((TIMSK2 & (1 << TOIE2)) && _now % SIM_TIMER2_PERIOD == 0) {
+            TIFR2 |= (1 << TOV2);
+            dispatchInterrupts();
+        }
+    }
+
+    if (_now >= _until) {
+        finish();
+    }
+}
+
+void Simulator::stepDevices(uint64_t to)
+{
+    uint64_t from = _now;
+    _now = to;
+
+    bool wasFlowing = _plant.isFlowing();
+    _plant.step(from, to);
+
+    if (wasFlowing != _plant.isFlowing()) {
+        trace("WATER %s", _plant.isFlowing() ? "flowing" : "stopped");
+        setPin(SIM_PIN_WATER_SENSOR, _plant.isFlowing() ? SIM_LOW : SIM_HIGH);
+    }
+
+    if (_pourButton != 0) {
+        if (_pourUntilMl < 0 && _plant.isFlowing()) {
+            _pourUntilMl = _plant.pouredMl + _plant.unitMl;
+        }
+        if (_pourUntilMl >= 0 && _plant.pouredMl >= _pourUntilMl) {
+            setButton(_pourButton, false);
+            _pourButton = 0;
+        }
+    }
+
+    if (!_servoAttached) {
+        return;
+    }
+
+    _servoAttachedTime += to - from;
+
+    if (_servoAngle != _servoTarget) {
+        double travel = SIM_SERVO_SPEED * (double) (to - from) / 1000;
+        if (fabs(_servoTarget - _servoAngle) <= travel) {
+            _servoAngle = _servoTarget;
+        }
+        else {
+            _servoAngle += _servoTarget > _servoAngle ? travel : -travel;
+        }
+    }
+
+    bool down = _servoAngle >= SIM_STRAW_DOWN_ANGLE;
+    if (down && !_plant.isStrawDown()) {
+        _plant.strawDown(to);
+        trace("STRAW down");
+    }
+    else if (!down && _plant.isStrawDown()) {
+        double ml = _plant.pouredMl - _plant.pourStartMl;
+        _plant.strawUp(to);
+        if (_pins[SIM_PIN_WATER_SENSOR] == SIM_LOW) {
+            trace("WATER stopped");
+            setPin(SIM_PIN_WATER_SENSOR, SIM_HIGH);
+        }
+
+        _pours++;
+        _pourSumMl += ml;
+        _pourSumSqMl += ml * ml;
+        trace("STRAW up: poured %.1f ml (%.2f units), straw %.0f ms, down %.0f ms",
+            ml, ml / _plant.unitMl, _plant.pourTimeToStrawMillis,
+            (double) (to - _plant.pourStartMicros) / 1000);
+    }
+}
+
+void Simulator::loopBegin()
+{
+    if (_loopStart != SIM_NONE) {
+        uint64_t gap = _now - _loopStart;
+        if (gap > _loopMaxGap) {
+            _loopMaxGap = gap;
+        }
+    }
+    _loopStart = _now;
+    _loops++;
+}
+
+void Simulator::loopEnd()
+{
+    advance(_loopCost);
+    traceScreen();
+}
+
+int Simulator::readPin(uint8_t pin)
+{
+    advance(SIM_COST_DIGITAL_IO);
+
+    if (pin >= SIM_PINS) {
+        return SIM_LOW;
+    }
+
+    return _pins[pin];
+}
+
+void Simulator::writePin(uint8_t pin, uint8_t val)
+{
+    advance(SIM_COST_DIGITAL_IO);
+
+    if (pin < SIM_PINS && pin != SIM_PIN_WATER_SENSOR) {
+        setPin(pin, val ? SIM_HIGH : SIM_LOW);
+    }
+}
+
+/*
+ * Drives a pin, mirrors it into its PINx register and flags the pin
+ * change interrupt of its port if the pin is masked in.
+ */
+void Simulator::setPin(uint8_t pin, uint8_t level)
+{
+    if (pin >= SIM_PINS || _pins[pin] == level) {
+        return;
+    }
+    _pins[pin] = level;
+
+    volatile uint8_t *port;
+    volatile uint8_t *mask;
+    uint8_t bit;
+    uint8_t group;
+
+    if (pin <= 7) {
+        port = &PIND; mask = &PCMSK2; bit = pin;      group = PCIE2;
+    }
+    else if (pin <= 13) {
+        port = &PINB; mask = &PCMSK0; bit = pin - 8;  group = PCIE0;
+    }
+    else {
+        port = &PINC; mask = &PCMSK1; bit = pin - 14; group = PCIE1;
+    }
+
+    if (level == SIM_HIGH) {
+        *port |= (1 << bit);
+    }
+    else {
+        *port &= ~(1 << bit);
+    }
+
+    if ((*mask & (1 << bit)) && (PCICR & (1 << group))) {
+        PCIFR |= (1 << group);
+        dispatchInterrupts();
+    }
+}
+
+void Simulator::setInterruptsEnabled(bool enabled)
+{
+    _interruptsEnabled = enabled;
+    dispatchInterrupts();
+}
+
+void Simulator::dispatchInterrupts()
+{
+    if (!_interruptsEnabled || _inInterrupt) {
+        return;
+    }
+
+    // the hardware clears the flag and masks interrupts while the handler runs
+    _inInterrupt = true;
+    while (PCIFR != 0 || TIFR0 != 0 || TIFR2 != 0) {
+        if (TIFR0 & (1 << OCF0A)) {
+            TIFR0 &= ~(1 << OCF0A);
+            if (TIMER0_COMPA_vect) TIMER0_COMPA_vect();
+        }
+        else if (TIFR2 & (1 << TOV2)) {
+            TIFR2 &= ~(1 << TOV2);
+            if (TIMER2_OVF_vect) TIMER2_OVF_vect();
+        }
+        else if (PCIFR & (1 << PCIF0)) {
+            PCIFR &= ~(1 << PCIF0);
+            if (PCINT0_vect) PCINT0_vect();
+        }
+        else if (PCIFR & (1 << PCIF1)) {
+            PCIFR &= ~(1 << PCIF1);
+            if (PCINT1_vect) PCINT1_vect();
+        }
+        else if (PCIFR & (1 << PCIF2)) {
+            PCIFR &= ~(1 << PCIF2);
+            if (PCINT2_vect) PCINT2_vect();
+        }
+        else {
+            TIFR0 = 0;
+            TIFR2 = 0;
+        }
+    }
+    _inInterrupt = false;
+}
+
+void Simulator::servoAttach(bool attached)
+{
+    if (attached != _servoAttached) {
+        trace("SERVO %s", attached ? "attached" : "detached");
+    }
+    _servoAttached = attached;
+}
+
+void Simulator::servoWrite(int angle)
+{
+    if (angle != _servoTarget) {
+        respond();
+    }
+    _servoTarget = angle;
+}
+
+/*
+ * The first LCD or servo access after a button edge counts as the
+ * firmware's response to it; edges left unanswered for a second do not.
+ */
+void Simulator::respond()
+{
+    if (_responsePending == SIM_NONE) {
+        return;
+    }
+
+    uint64_t latency = _now - _responsePending;
+    _responsePending = SIM_NONE;
+    if (latency > 1000000) {
+        return;
+    }
+
+    _responses++;
+    _responseLatencySum += latency;
+    if (latency > _responseLatencyMax) {
+        _responseLatencyMax = latency;
+    }
+}
+
+void Simulator::lcdClear()
+{
+    respond();
+    _lcdLastAccess = _now;
+    memset(_ddram, ' ', sizeof(_ddram));
+    _lcdClears++;
+    _lcdBusTime += SIM_COST_LCD_BYTE + SIM_COST_LCD_CLEAR;
+    advance(SIM_COST_LCD_BYTE + SIM_COST_LCD_CLEAR);
+}
+
+void Simulator::lcdCommand()
+{
+    respond();
+    _lcdLastAccess = _now;
+    _lcdBusTime += SIM_COST_LCD_BYTE;
+    advance(SIM_COST_LCD_BYTE);
+}
+
+void Simulator::lcdWrite(uint8_t address, uint8_t c)
+{
+    respond();
+    _lcdLastAccess = _now;
+
+    int row = (address & 0x40) ? 1 : 0;
+    int col = address & 0x3F;
+    if (col < 40) {
+        _ddram[row][col] = (char) c;
+    }
+
+    _lcdBytes++;
+    _lcdBusTime += SIM_COST_LCD_BYTE;
+    advance(SIM_COST_LCD_BYTE);
+}
+
+void Simulator::traceScreen()
+{
+    if (_now - _lcdLastAccess < SIM_LCD_SETTLE) {
+        return;
+    }
+
+    bool changed = false;
+    for (int row = 0; row < 2; row++) {
+        for (int col = 0; col < 16; col++) {
+            char c = _ddram[row][col];
+            if (c < ' ' || c > '~') {
+                c = '?';
+            }
+            if (_shownScreen[row][col] != c) {
+                _shownScreen[row][col] = c;
+                changed = true;
+            }
+        }
+    }
+
+    if (changed) {
+        trace("LCD |%s|%s|", _shownScreen[0], _shownScreen[1]);
+    }
+}
+
+uint8_t Simulator::eepromRead(unsigned int address)
+{
+    eepromWait();
+    return address < SIM_EEPROM_SIZE ? _eeprom[address] : 0xFF;
+}
+
+void Simulator::eepromWrite(unsigned int address, uint8_t value)
+{
+    eepromWait();
+    if (address >= SIM_EEPROM_SIZE) {
+        return;
+    }
+
+    _eeprom[address] = value;
+    _eepromWrites[address]++;
+    _eepromReadyAt = _now + SIM_COST_EEPROM_WRITE;
+}
+
+bool Simulator::eepromIsReady()
+{
+    return _now >= _eepromReadyAt;
+}
+
+// avr-libc polls EEPE before every access
+void Simulator::eepromWait()
+{
+    if (_now < _eepromReadyAt) {
+        _eepromBlockedTime += _eepromReadyAt - _now;
+        advance(_eepromReadyAt - _now);
+    }
+}
+
+void Simulator::serialBegin(unsigned long baud)
+{
+    // a start bit, 8 data bits and a stop bit
+    _serialByteTime = baud > 0 ? 10000000ULL / baud : 0;
+    _serialIdleAt = _now;
+}
+
+uint16_t Simulator::getFreeMemory()
+{
+    return _freeMemory;
+}
+
+int Simulator::serialAvailableForWrite()
+{
+    if (_serialByteTime == 0) {
+        return 0;
+    }
+
+    uint64_t pending = _serialIdleAt > _now ?
+        (_serialIdleAt - _now + _serialByteTime - 1) / _serialByteTime : 0;
+    return SERIAL_TX_BUFFER_SIZE - 1 - (int) pending;
+}
+
+void Simulator::serialWrite(uint8_t c)
+{
+    if (_serialByteTime == 0) {
+        return;
+    }
+
+    // a full buffer makes write() wait for the line, as on the board
+    while (serialAvailableForWrite() <= 0) {
+        uint64_t from = _now;
+        advance(_serialByteTime);
+        _serialBlockedTime += _now - from;
+    }
+
+    _serialIdleAt = (_serialIdleAt > _now ? _serialIdleAt : _now) + _serialByteTime;
+    _serialBytes++;
+    if (_serialFile != NULL) {
+        fputc(c, _serialFile);
+    }
+    advance(SIM_COST_SERIAL_BYTE);
+}
+
+void Simulator::serialFlush()
+{
+    if (_serialIdleAt > _now) {
+        advance(_serialIdleAt - _now);
+    }
+}
+
+void Simulator::trace(const char *fmt, ...)
+{
+    if (_quiet) {
+        return;
+    }
+
+    printf("[%12.3f] ", (double) _now / 1e6);
+
+    va_list args;
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+
+    printf("\n");
+}
+
+void Simulator::report()
+{
+    double seconds = (double) _now / 1e6;
+
+    unsigned long eepromBytes = 0;
+    unsigned long eepromMaxWrites = 0;
+    for (int i = 0; i < SIM_EEPROM_SIZE; i++) {
+        eepromBytes += _eepromWrites[i];
+        if (_eepromWrites[i] > eepromMaxWrites) {
+            eepromMaxWrites = _eepromWrites[i];
+        }
+    }
+
+    printf("\n");
+    printf("virtual time   %.3f s\n", seconds);
+    printf("loop()         %lu passes, %.1f Hz, longest pass %.3f ms\n",
+        _loops, _loops / seconds, (double) _loopMaxGap / 1000);
+    printf("buttons        %lu responses, mean latency %.3f ms, max %.3f ms\n",
+        _responses,
+        _responses ? (double) _responseLatencySum / _responses / 1000 : 0.0,
+        (double) _responseLatencyMax / 1000);
+    printf("lcd            %lu bytes, %lu clears, %.1f ms on the bus\n",
+        _lcdBytes, _lcdClears, (double) _lcdBusTime / 1000);
+    printf("servo          attached %.1f s\n", (double) _servoAttachedTime / 1e6);
+    printf("eeprom         %lu byte writes, %lu on the most worn cell, %.3f ms waiting for a write\n",
+        eepromBytes, eepromMaxWrites, (double) _eepromBlockedTime / 1000);
+    printf("serial         %lu bytes, %.3f ms waiting for the line\n",
+        _serialBytes, (double) _serialBlockedTime / 1000);
+
+    if (_pours > 0) {
+        double mean = _pourSumMl / _pours;
+        double var = _pourSumSqMl / _pours - mean * mean;
+        printf("pours          %lu, mean %.2f units, sd %.2f units, reservoir at %.0f%%\n",
+            _pours, mean / _plant.unitMl, sqrt(var > 0 ? var : 0) / _plant.unitMl,
+            _plant.getLevel() * 100);
+    }
+    else {
+        printf("pours          0, reservoir at %.0f%%\n", _plant.getLevel() * 100);
+    }
+}
+
+void Simulator::finish()
+{
+    traceScreen();
+    report();
+
+    if (_eepromPath != NULL) {
+        FILE *f = fopen(_eepromPath, "wb");
+        if (f == NULL || fwrite(_eeprom, 1, sizeof(_eeprom), f) != sizeof(_eeprom)) {
+            perror(_eepromPath);
+        }
+        if (f != NULL) {
+            fclose(f);
+        }
+    }
+
+    if (_serialFile != NULL) {
+        fclose(_serialFile);
+    }
+
+    fflush(stdout);
+    exit(0);
+}
@@ -0,0 +1,193 @@
+/*
+ * Simulator.h - Virtual clock and board model for running the sketch on a host.
+ * Released into the public domain.
+ *
+ * The stubs in stubs/ forward every hardware access here. Nothing ever
+ * sleeps: delay() and the modelled cost of each bus transfer advance a
+ * virtual microsecond clock, so hours of device time run in seconds.
+ */
+
+#ifndef Simulator_h
+#define Simulator_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include "Plant.h"
+
+// wiring, as in src/sketch.ino
+#define SIM_PIN_MOTOR 2
+#define SIM_PIN_BUTTON1 3
+#define SIM_PIN_BUTTON2 4
+#define SIM_PIN_BUTTON3 7
+#define SIM_PIN_WATER_SENSOR 9
+#define SIM_PIN_LED 13
+
+#define SIM_PINS 20
+#define SIM_LOW 0
+#define SIM_HIGH 1
+#define SIM_EEPROM_SIZE 1024
+#define SIM_SCRIPT_SIZE 512
+
+// free RAM reported to the sketch by default, see stubs/MemoryMonitor.cpp
+#define SIM_FREE_MEMORY 600
+
+// modelled cost of the hardware accesses, in microseconds
+#define SIM_COST_DIGITAL_IO 4
+#define SIM_COST_LCD_BYTE 264
+#define SIM_COST_LCD_CLEAR 2000
+#define SIM_COST_EEPROM_WRITE 3400
+#define SIM_COST_SERIAL_BYTE 4
+
+// the screen is traced once it has not changed for this long
+#define SIM_LCD_SETTLE 20000
+
+// timer 0 overflows every 1024 us at 16 MHz with the core's /64 prescaler
+#define SIM_TIMER0_PERIOD 1024
+
+// timer 2 counts 2 us ticks and overflows every 512 us, see stubs/avr/io.h
+#define SIM_TIMER2_TICK 2
+#define SIM_TIMER2_PERIOD 512
+
+// servo slew rate (degrees per millisecond) and straw depth
+#define SIM_SERVO_SPEED 0.6
+#define SIM_STRAW_DOWN_ANGLE 45
+
+enum sim_command_t {
+    SIM_CMD_PRESS,
+    SIM_CMD_RELEASE,
+    SIM_CMD_POUR,
+    SIM_CMD_GAP,
+    SIM_CMD_LEVEL
+};
+
+class Simulator
+{
+    public:
+        Simulator();
+
+        // parses the command line; returns false on a usage error
+        bool begin(int argc, char **argv);
+
+        // virtual time since power-on
+        uint64_t now();
+        uint32_t millis32();
+        uint32_t micros32();
+        void advance(uint64_t us);
+
+        // called by the driver around each loop() pass
+        void loopBegin();
+        void loopEnd();
+
+        // board
+        int readPin(uint8_t pin);
+        void writePin(uint8_t pin, uint8_t val);
+
+        // sei()/cli(); pending pin change interrupts run on sei()
+        void setInterruptsEnabled(bool enabled);
+
+        void servoAttach(bool attached);
+        void servoWrite(int angle);
+
+        void lcdClear();
+        void lcdCommand();
+        void lcdSetAddress(uint8_t address);
+        void lcdWrite(uint8_t address, uint8_t c);
+
+        // a write goes on in the background, the next access waits for it
+        uint8_t eepromRead(unsigned int address);
+        void eepromWrite(unsigned int address, uint8_t value);
+        bool eepromIsReady();
+        void eepromWait();
+
+        // baud 0 is a closed port, which drops what is written
+        void serialBegin(unsigned long baud);
+        int serialAvailableForWrite();
+        void serialWrite(uint8_t c);
+        void serialFlush();
+
+        // what the board has between the heap and the stack, see -M
+        uint16_t getFreeMemory();
+
+        // prints the screen if it changed and has not been written for a while
+        void traceScreen();
+
+        void finish();
+
+    private:
+        bool loadScript(const char *path);
+        void addEvent(uint64_t at, sim_command_t cmd, double arg);
+        void runEvent(int index);
+        void setButton(int button, bool pressed);
+        void setPin(uint8_t pin, uint8_t level);
+        void respond();
+        void dispatchInterrupts();
+        void stepDevices(uint64_t to);
+        void report();
+        void trace(const char *fmt, ...);
+
+        uint64_t _now;
+        uint64_t _startOffset;
+        uint64_t _until;
+        uint64_t _loopCost;
+        bool _quiet;
+        const char *_eepromPath;
+        FILE *_serialFile;
+        uint16_t _freeMemory;
+
+        // scripted stimulus
+        struct {
+            uint64_t at;
+            sim_command_t cmd;
+            double arg;
+        } _script[SIM_SCRIPT_SIZE];
+        int _scriptSize;
+        int _scriptNext;
+        int _pourButton;
+        double _pourUntilMl;
+
+        uint8_t _pins[SIM_PINS];
+        bool _interruptsEnabled;
+        bool _inInterrupt;
+
+        Plant _plant;
+
+        bool _servoAttached;
+        double _servoAngle;
+        int _servoTarget;
+
+        char _ddram[2][40];
+        char _shownScreen[2][17];
+        uint64_t _lcdLastAccess;
+
+        uint8_t _eeprom[SIM_EEPROM_SIZE];
+        unsigned long _eepromWrites[SIM_EEPROM_SIZE];
+        uint64_t _eepromReadyAt;
+
+        // a byte takes _serialByteTime on the line, the last one queued
+        // is out at _serialIdleAt
+        uint64_t _serialByteTime;
+        uint64_t _serialIdleAt;
+
+        // statistics
+        unsigned long _loops;
+        uint64_t _loopStart;
+        uint64_t _loopMaxGap;
+        uint64_t _responsePending;
+        unsigned long _responses;
+        uint64_t _responseLatencySum;
+        uint64_t _responseLatencyMax;
+        unsigned long _lcdBytes;
+        unsigned long _lcdClears;
+        uint64_t _lcdBusTime;
+        uint64_t _servoAttachedTime;
+        unsigned long _serialBytes;
+        uint64_t _serialBlockedTime;
+        uint64_t _eepromBlockedTime;
+        unsigned long _pours;
+        double _pourSumMl;
+        double _pourSumSqMl;
+};
+
+extern Simulator Sim;
+
+#endif
@@ -0,0 +1,87 @@
+#!/bin/sh
+#
+# check-schedule.sh - Runs the automatic schedule for weeks and checks it
+# does not drift.
+# Released into the public domain.
+#
+# Plays scripts/calibrate-and-schedule.txt, which sets up 2 units every
+# 30 minutes, for WEEKS simulated weeks with millis() wrapping around
+# halfway through. Pour k (counted from the first, empty reservoir ones
+# included) has to start k periods after the first one: none missed,
+# none extra. A pour starts when the loop notices its deadline, so each
+# one is a loop pass or so late; how late may vary by LATE_MS over the
+# whole run and no more, where a schedule that drifted by even 1 ms a
+# batch would be off by a second after 3 weeks.
+#
+#   ./check-schedule.sh build
+#   WEEKS=1 ./check-schedule.sh build
+#
+# Takes a couple of minutes for the default 3 weeks.
+
+if [ $# -ne 1 ] || [ ! -d "$1" ]; then
+    echo "usage: $0 build-dir" >&2
+    exit 1
+fi
+
+DIR=$(dirname "$0")
+WEEKS=${WEEKS:-3}
+PERIOD=1800000
+WRAP=4294967296
+LATE_MS=${LATE_MS:-20}
+SECONDS_RUN=$((WEEKS * 7 * 86400))
+START=$((WRAP - SECONDS_RUN * 500))
+SERIAL="$1/check-schedule.bin"
+
+# a 5 ms loop keeps weeks quick, the schedule runs from a task anyway
+"$DIR/trampolino-sim" -q -l 5000 -s $START -t $SECONDS_RUN -S "$SERIAL" \
+    "$DIR/scripts/calibrate-and-schedule.txt" > /dev/null || exit 1
+
+"$DIR/decode-telemetry" "$SERIAL" | awk -v period=$PERIOD -v wrap=$WRAP \
+        -v start=$START -v run=$SECONDS_RUN -v tolerance=$LATE_MS '
+    $2 == "pour" && $3 == "at" {
+        at = int($4 * 1000 + 0.5) + turns * wrap
+        if (n > 0 && at < last) {
+            turns++
+            at += wrap
+        }
+        if (n == 0) {
+            first = at
+        }
+
+        k = int((at - first) / period + 0.5)
+        late = at - first - k * period
+        if (k != n) {
+            printf("pour %d at %.3f s is batch %d\n", n, (at - first) / 1000, k)
+            bad++
+        }
+        if (n == 0 || late < earliest) {
+            earliest = late
+        }
+        if (n == 0 || late > latest) {
+            latest = late
+        }
+        last = at
+        n++
+    }
+    END {
+        # the first batch is set up a few minutes in
+        expected = int((start + run * 1000 - first) / period) + 1
+        if (n != expected) {
+            printf("%d pours, expected %d\n", n, expected)
+            bad++
+        }
+        if (turns == 0) {
+            print "millis() never wrapped around"
+            bad++
+        }
+        if (latest - earliest > tolerance) {
+            printf("pours started from %d to %d ms off the period, more than %d ms apart\n",
+                earliest, latest, tolerance)
+            bad++
+        }
+        if (bad) {
+            exit 1
+        }
+        printf("%d pours %d s apart across a millis() rollover, all within %d ms of the period\n",
+            n, period / 1000, latest - earliest)
+    }'
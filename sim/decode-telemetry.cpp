@@ -0,0 +1,277 @@
+/*
+ * decode-telemetry.cpp - Prints the records the sketch sends over Serial.
+ * Released into the public domain.
+ *
+ * Reads the raw byte stream, from a file such as the one trampolino-sim
+ * -S writes or from a serial port, and prints one line per record. See
+ * lib/Telemetry for the framing and src/PourTelemetry.h for the records.
+ *
+ *   ./decode-telemetry serial.bin
+ *   stty -F /dev/ttyACM0 115200 raw && ./decode-telemetry /dev/ttyACM0
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "stubs/util/crc16.h"
+#include "../src/PourTelemetry.h"
+
+// a whole frame, delimiter aside
+#define FRAME_MAX 256
+
+static unsigned long frames = 0;
+static unsigned long badFrames = 0;
+static unsigned long lost = 0;
+static bool haveSequence = false;
+static uint16_t nextSequence;
+
+static void printPour(uint16_t sequence, const uint8_t *data, int length)
+{
+    if (length != (int) sizeof(pour_telemetry_t)) {
+        printf("%5u pour: %d bytes, expected %d\n",
+            sequence, length, (int) sizeof(pour_telemetry_t));
+        return;
+    }
+
+    pour_telemetry_t pour;
+    memcpy(&pour, data, sizeof(pour));
+
+    printf("%5u pour at %.3f s: %u units, time to straw %u ms",
+        sequence, pour.start / 1000.0, pour.units, pour.timeToStraw);
+    if (pour.predictedTimeToStraw >= 0) {
+        printf(" (predicted %d)", pour.predictedTimeToStraw);
+    }
+    printf(", wet %u ms of %u planned, down %u ms, correction %d ms",
+        pour.wet, pour.plannedWet, pour.down, pour.correction);
+    if (pour.gaps > 0) {
+        printf(", %u gaps", pour.gaps);
+    }
+    if (pour.flags & POUR_TELEMETRY_INTERRUPTED) {
+        printf(", interrupted");
+    }
+    if (pour.flags & POUR_TELEMETRY_EMPTY) {
+        printf(", reservoir empty");
+    }
+    printf("\n");
+}
+
+static void printHistory(uint16_t sequence, const uint8_t *data, int length)
+{
+    if (length != (int) sizeof(history_telemetry_t)) {
+        printf("%5u history: %d bytes, expected %d\n",
+            sequence, length, (int) sizeof(history_telemetry_t));
+        return;
+    }
+
+    history_telemetry_t entry;
+    memcpy(&entry, data, sizeof(entry));
+
+    printf("%5u history: %u units %u min after %s, time to straw %u ms, down %lu ms",
+        sequence, entry.units, entry.minutesBefore,
+        entry.flags & POUR_TELEMETRY_POWER_ON ? "power-on" : "the pour before",
+        entry.timeToStraw, (unsigned long) entry.down);
+    if (entry.flags & POUR_TELEMETRY_INTERRUPTED) {
+        printf(", interrupted");
+    }
+    if (entry.flags & POUR_TELEMETRY_EMPTY) {
+        printf(", reservoir empty");
+    }
+    printf("\n");
+}
+
+static void printMemory(uint16_t sequence, const uint8_t *data, int length)
+{
+    if (length != (int) sizeof(memory_telemetry_t)) {
+        printf("%5u memory: %d bytes, expected %d\n",
+            sequence, length, (int) sizeof(memory_telemetry_t));
+        return;
+    }
+
+    memory_telemetry_t memory;
+    memcpy(&memory, data, sizeof(memory));
+
+    printf("%5u memory: %u bytes free, %u never reached by the stack, stack at most %u\n",
+        sequence, memory.freeMemory, memory.unusedStack, memory.stackHighWater);
+}
+
+// in profile_slot_t order, see lib/Profiler
+static const char *profileNames[] = {
+    "loop", "lcd", "buttons", "realtime", "messages", "pour", "fit", "estimate"
+};
+
+static void printProfile(uint16_t sequence, const uint8_t *data, int length)
+{
+    if (length != (int) sizeof(profile_telemetry_t)) {
+        printf("%5u profile: %d bytes, expected %d\n",
+            sequence, length, (int) sizeof(profile_telemetry_t));
+        return;
+    }
+
+    profile_telemetry_t profile;
+    memcpy(&profile, data, sizeof(profile));
+
+    unsigned long count = 0;
+    for (int i = 0; i < PROFILE_TELEMETRY_BUCKETS; i++) {
+        count += profile.buckets[i];
+    }
+
+    // the bucket the 99th percentile is in, as the sketch works it out
+    int p99 = PROFILE_TELEMETRY_BUCKETS - 1;
+    unsigned long above = profile.buckets[p99];
+    while (p99 > 0 && above <= count / 100) {
+        above += profile.buckets[--p99];
+    }
+
+    if (profile.slot < sizeof(profileNames) / sizeof(profileNames[0])) {
+        printf("%5u profile %s:", sequence, profileNames[profile.slot]);
+    }
+    else {
+        printf("%5u profile slot %u:", sequence, profile.slot);
+    }
+    printf(" %lu times, 99%% ", count);
+    if (p99 < PROFILE_TELEMETRY_BUCKETS - 1) {
+        printf("under %lu us", 16UL << (2 * p99));
+    }
+    else {
+        printf("over %lu us", 16UL << (2 * (p99 - 1)));
+    }
+    printf(", max %lu us |", (unsigned long) profile.maxMicros);
+    for (int i = 0; i < PROFILE_TELEMETRY_BUCKETS; i++) {
+        printf(" %u", profile.buckets[i]);
+    }
+    printf("\n");
+}
+
+static void printCurve(uint16_t sequence, const uint8_t *data, int length)
+{
+    curve_telemetry_t curve;
+    int count = (length - (int) offsetof(curve_telemetry_t, params)) / (int) sizeof(float);
+    if (count < 0 || count > CURVE_TELEMETRY_MAX_PARAMS) {
+        printf("%5u curve: %d bytes\n", sequence, length);
+        return;
+    }
+    memcpy(&curve, data, length);
+
+    printf("%5u curve from %u points:", sequence, curve.pointCount);
+    for (int i = 0; i < count; i++) {
+        printf(" %g", curve.params[i]);
+    }
+    printf("\n");
+}
+
+/*
+ * Undoes the COBS encoding in place: each code byte is how far on the
+ * next zero was, the last one standing for the end of the frame.
+ */
+static int unstuff(uint8_t *frame, int length)
+{
+    int in = 0;
+    int out = 0;
+    while (in < length) {
+        int code = frame[in++];
+        if (code == 0 || in + code - 1 > length) {
+            return -1;
+        }
+        for (int i = 1; i < code; i++) {
+            frame[out++] = frame[in++];
+        }
+        if (in < length) {
+            frame[out++] = 0;
+        }
+    }
+    return out;
+}
+
+static void decodeFrame(uint8_t *frame, int length)
+{
+    length = unstuff(frame, length);
+
+    // sequence, type and CRC at least
+    uint16_t crc = 0;
+    for (int i = 0; i < length - 2; i++) {
+        crc = _crc16_update(crc, frame[i]);
+    }
+    if (length < 5 || (frame[length-2] | frame[length-1] << 8) != crc) {
+        badFrames++;
+        printf("    - bad frame\n");
+        return;
+    }
+    frames++;
+
+    uint16_t sequence = frame[0] | frame[1] << 8;
+    if (haveSequence && sequence != nextSequence) {
+        uint16_t missing = sequence - nextSequence;
+        lost += missing;
+        printf("    - %u records lost\n", missing);
+    }
+    haveSequence = true;
+    nextSequence = sequence + 1;
+
+    const uint8_t *data = frame + 3;
+    int dataLength = length - 5;
+    switch (frame[2]) {
+        case TELEMETRY_POUR:
+            printPour(sequence, data, dataLength);
+            break;
+        case TELEMETRY_CURVE:
+            printCurve(sequence, data, dataLength);
+            break;
+        case TELEMETRY_HISTORY:
+            printHistory(sequence, data, dataLength);
+            break;
+        case TELEMETRY_PROFILE:
+            printProfile(sequence, data, dataLength);
+            break;
+        case TELEMETRY_MEMORY:
+            printMemory(sequence, data, dataLength);
+            break;
+        default:
+            printf("%5u unknown record type %u\n", sequence, frame[2]);
+            break;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    FILE *f = stdin;
+    if (argc > 2) {
+        fprintf(stderr, "usage: %s [file]\n", argv[0]);
+        return 2;
+    }
+    if (argc == 2 && (f = fopen(argv[1], "rb")) == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    // started in the middle of a frame, that one fails its CRC
+    uint8_t frame[FRAME_MAX];
+    int length = 0;
+    bool overflow = false;
+    int c;
+    while ((c = fgetc(f)) != EOF) {
+        if (c != 0) {
+            if (length < FRAME_MAX) {
+                frame[length++] = c;
+            }
+            else {
+                overflow = true;
+            }
+            continue;
+        }
+
+        if (length > 0) {
+            if (overflow) {
+                badFrames++;
+                printf("    - bad frame\n");
+            }
+            else {
+                decodeFrame(frame, length);
+            }
+        }
+        length = 0;
+        overflow = false;
+    }
+
+    printf("%lu records, %lu lost, %lu bad frames\n", frames, lost, badFrames);
+    return 0;
+}
@@ -0,0 +1,23 @@
+/*
+ * main.cpp - Runs src/sketch.ino against the simulated board.
+ * Released into the public domain.
+ */
+
+#include "Simulator.h"
+
+void setup();
+void loop();
+
+int main(int argc, char **argv)
+{
+    if (!Sim.begin(argc, argv)) {
+        return 2;
+    }
+
+    setup();
+    for (;;) {
+        Sim.loopBegin();
+        loop();
+        Sim.loopEnd();
+    }
+}
@@ -0,0 +1,61 @@
+#!/bin/sh
+#
+# ram-report.sh - Static RAM of a build, by library.
+# Released into the public domain.
+#
+# Adds up the RAM sections of every object under a build directory,
+# by the lib/ directory it was built from, then lists the sketch's own
+# globals largest first: the library instances are among them. Stack
+# and heap come out of what is left, see lib/MemoryMonitor.
+#
+#   SIZE=avr-size NM=avr-nm ./ram-report.sh ../.build/uno
+#   ./ram-report.sh build
+#
+# On the AVR constant data without PROGMEM is copied to RAM too, so
+# .rodata is counted there. Host objects only give an idea: pointers
+# and doubles are twice as big as on the board.
+
+if [ $# -ne 1 ] || [ ! -d "$1" ]; then
+    echo "usage: $0 build-dir" >&2
+    exit 1
+fi
+
+SIZE=${SIZE:-size}
+NM=${NM:-nm}
+LIBS=$(ls "$(dirname "$0")/../lib")
+
+case "$SIZE" in
+    *avr*) SECTIONS='^\.(data|bss|rodata)' ;;
+    *)     SECTIONS='^\.(data|bss)' ;;
+esac
+
+for object in $(find "$1" -name '*.o' | sort); do
+    dir=$(basename "$(dirname "$object")")
+    part=core
+    for lib in $LIBS; do
+        [ "$dir" = "$lib" ] && part=$lib
+    done
+    case "$object" in
+        */sketch.o|*/sketch.ino.o|*/sketch.cpp.o) part=sketch ;;
+    esac
+
+    "$SIZE" -A "$object" | awk -v part="$part" -v sections="$SECTIONS" \
+        '$1 ~ sections && $1 !~ /rel\.ro/ { sum += $2 } END { print part, sum + 0 }'
+done | awk '
+    { bytes[$1] += $2; total += $2 }
+    END {
+        for (part in bytes) {
+            if (bytes[part] > 0) {
+                printf "%6d  %s\n", bytes[part], part
+            }
+        }
+        printf "%6d  total\n", total
+    }' | sort -n
+
+sketch=$(find "$1" -name 'sketch*.o' | head -n 1)
+if [ -n "$sketch" ]; then
+    echo
+    echo "sketch globals:"
+    "$NM" -S -C -t d --size-sort -r "$sketch" |
+        awk '$3 ~ /^[bBdD]$/ { printf "%6d  %s\n", $2, substr($0, index($0, $4)) }'
+fi
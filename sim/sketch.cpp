@@ -0,0 +1,39 @@
+/*
+ * sketch.cpp - Builds src/sketch.ino as plain C++ for the simulator.
+ * Released into the public domain.
+ *
+ * The Arduino build adds Arduino.h and prototypes for every function
+ * in the sketch; this file does the same by hand.
+ */
+
+#include <Arduino.h>
+#include <LcdManager.h>
+#include <HistoryLog.h>
+#include <RecordStore.h>
+#include "../src/PourTelemetry.h"
+
+void initMotor();
+void strawDown();
+void strawUp();
+bool isWaterFlowing();
+void realtimeLoop();
+uint32_t pourTask(void *context);
+double estimateWetMillis(double timeToStraw, uint8_t units);
+void predictPour();
+void updatePourCorrection(double errorMillis);
+void loadPourCorrection();
+void recordPour(uint8_t flags);
+void appendHistory(const pour_telemetry_t *record);
+bool readHistory(history_cursor_t *cursor, history_telemetry_t *entry);
+void recordCurve();
+void recordMemory();
+bool hasMemoryForFit();
+uint32_t telemetryTask(void *context);
+uint32_t historyTask(void *context);
+uint32_t profileTask(void *context);
+void saveRecord(RecordStore *store, const void *record, uint16_t length);
+uint32_t eepromTask(void *context);
+uint32_t motorTask(void *context);
+uint32_t lcdLoopTask(void *context);
+
+#include "../src/sketch.ino"
@@ -0,0 +1,59 @@
+/*
+ * Arduino.cpp - Host stand-in for the Arduino core, used by the simulator.
+ * Released into the public domain.
+ */
+
+#include "Arduino.h"
+#include "../Simulator.h"
+
+unsigned long millis(void)
+{
+    return Sim.millis32();
+}
+
+unsigned long micros(void)
+{
+    return Sim.micros32();
+}
+
+void delay(unsigned long ms)
+{
+    Sim.advance((uint64_t) ms * 1000);
+    Sim.traceScreen();
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    Sim.advance(us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    (void) pin;
+    (void) mode;
+}
+
+int digitalRead(uint8_t pin)
+{
+    return Sim.readPin(pin);
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+    Sim.writePin(pin, val);
+}
+
+void sim_sei(void)
+{
+    Sim.setInterruptsEnabled(true);
+}
+
+void sim_cli(void)
+{
+    Sim.setInterruptsEnabled(false);
+}
+
+uint8_t sim_timer2_count(void)
+{
+    return (uint8_t) (Sim.now() / SIM_TIMER2_TICK);
+}
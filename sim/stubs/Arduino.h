@@ -0,0 +1,73 @@
+/*
+ * Arduino.h - Host stand-in for the Arduino core, used by the simulator.
+ * Released into the public domain.
+ *
+ * Only the subset of the core used by the sketch and the libraries in lib/
+ * is provided. Time is virtual: delay() advances the simulator clock
+ * instead of sleeping.
+ */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#include "Print.h"
+#include "HardwareSerial.h"
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+#define interrupts() sei()
+#define noInterrupts() cli()
+
+// Arduino Uno pin mapping, as in pins_arduino.h
+#define NOT_A_PORT 0
+#define PB 2
+#define PC 3
+#define PD 4
+
+#define digitalPinToPort(p) (((p) <= 7) ? PD : (((p) <= 13) ? PB : PC))
+#define digitalPinToBitMask(p) (1 << (((p) <= 7) ? (p) : (((p) <= 13) ? (p) - 8 : (p) - 14)))
+#define portInputRegister(port) ((port) == PB ? &PINB : ((port) == PC ? &PINC : &PIND))
+
+#define digitalPinToPCICR(p) (((p) >= 0 && (p) <= 21) ? (&PCICR) : ((volatile uint8_t *)0))
+#define digitalPinToPCICRbit(p) (((p) <= 7) ? 2 : (((p) <= 13) ? 0 : 1))
+#define digitalPinToPCMSK(p) (((p) <= 7) ? (&PCMSK2) : (((p) <= 13) ? (&PCMSK0) : (((p) <= 21) ? (&PCMSK1) : ((volatile uint8_t *)0))))
+#define digitalPinToPCMSKbit(p) (((p) <= 7) ? (p) : (((p) <= 13) ? ((p) - 8) : ((p) - 14)))
+
+/*
+ * avr-gcc implements double as a 32-bit float. Mirror that here so the
+ * curve fitting runs at the precision it has on the board and anything
+ * written with sizeof(double) keeps its on-device layout.
+ */
+#define double float
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t val);
+
+#endif
@@ -0,0 +1,35 @@
+/*
+ * HardwareSerial.cpp - Host stand-in for the Arduino Serial port, used by the simulator.
+ * Released into the public domain.
+ */
+
+#include "HardwareSerial.h"
+#include "../Simulator.h"
+
+HardwareSerial Serial;
+
+void HardwareSerial::begin(unsigned long baud)
+{
+    Sim.serialBegin(baud);
+}
+
+void HardwareSerial::end()
+{
+    Sim.serialBegin(0);
+}
+
+int HardwareSerial::availableForWrite()
+{
+    return Sim.serialAvailableForWrite();
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    Sim.serialWrite(c);
+    return 1;
+}
+
+void HardwareSerial::flush()
+{
+    Sim.serialFlush();
+}
@@ -0,0 +1,34 @@
+/*
+ * HardwareSerial.h - Host stand-in for the Arduino Serial port, used by the simulator.
+ * Released into the public domain.
+ *
+ * Models the core's transmit buffer draining at the baud rate, so that
+ * availableForWrite() and a write() to a full buffer behave as on the
+ * board. What is sent can be saved to a file, see -S.
+ */
+
+#ifndef HardwareSerial_h
+#define HardwareSerial_h
+
+#include <stdint.h>
+#include "Print.h"
+
+// as in the AVR core, one slot is always left empty
+#define SERIAL_TX_BUFFER_SIZE 64
+
+class HardwareSerial : public Print
+{
+    public:
+        void begin(unsigned long baud);
+        void end();
+
+        virtual int availableForWrite();
+        virtual size_t write(uint8_t c);
+        using Print::write;
+
+        void flush();
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,56 @@
+/*
+ * LiquidCrystal.cpp - Host stand-in for the HD44780 driver, used by the simulator.
+ * Released into the public domain.
+ */
+
+#include "LiquidCrystal.h"
+#include "../Simulator.h"
+
+LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t enable,
+    uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3)
+{
+    (void) rs; (void) enable;
+    (void) d0; (void) d1; (void) d2; (void) d3;
+    _address = 0;
+}
+
+void LiquidCrystal::begin(uint8_t cols, uint8_t rows)
+{
+    (void) cols;
+    (void) rows;
+    clear();
+}
+
+void LiquidCrystal::clear()
+{
+    _address = 0;
+    Sim.lcdClear();
+}
+
+void LiquidCrystal::home()
+{
+    _address = 0;
+    Sim.lcdClear();
+}
+
+void LiquidCrystal::setCursor(uint8_t col, uint8_t row)
+{
+    _address = col + (row ? 0x40 : 0x00);
+    Sim.lcdCommand();
+}
+
+size_t LiquidCrystal::write(uint8_t c)
+{
+    Sim.lcdWrite(_address, c);
+
+    // the address counter runs along a 40 character line, then wraps
+    _address++;
+    if (_address == 0x28) {
+        _address = 0x40;
+    }
+    else if (_address == 0x68) {
+        _address = 0x00;
+    }
+
+    return 1;
+}
@@ -0,0 +1,33 @@
+/*
+ * LiquidCrystal.h - Host stand-in for the HD44780 driver, used by the simulator.
+ * Released into the public domain.
+ *
+ * Keeps the controller's display RAM so the simulator can show the screen,
+ * and charges the virtual clock what the 4-bit bus would cost on the board.
+ */
+
+#ifndef LiquidCrystal_h
+#define LiquidCrystal_h
+
+#include <stdint.h>
+#include "Print.h"
+
+class LiquidCrystal : public Print
+{
+    public:
+        LiquidCrystal(uint8_t rs, uint8_t enable,
+            uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3);
+
+        void begin(uint8_t cols, uint8_t rows);
+        void clear();
+        void home();
+        void setCursor(uint8_t col, uint8_t row);
+
+        virtual size_t write(uint8_t c);
+        using Print::write;
+
+    private:
+        uint8_t _address;
+};
+
+#endif
@@ -0,0 +1,26 @@
+/*
+ * MemoryMonitor.cpp - Host stand-in for lib/MemoryMonitor, used by the simulator.
+ * Released into the public domain.
+ *
+ * The host has no AVR RAM to paint, so the free RAM is whatever -M
+ * says, and the stack is taken to have never come any closer: how
+ * deep it goes on the board is not modelled.
+ */
+
+#include <MemoryMonitor.h>
+#include "../Simulator.h"
+
+uint16_t MemoryMonitor::getFreeMemory()
+{
+    return Sim.getFreeMemory();
+}
+
+uint16_t MemoryMonitor::getUnusedStack()
+{
+    return Sim.getFreeMemory();
+}
+
+uint16_t MemoryMonitor::getStackHighWater()
+{
+    return 0;
+}
@@ -0,0 +1,102 @@
+/*
+ * Print.cpp - Host stand-in for the Arduino Print class, used by the simulator.
+ * Released into the public domain.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "Print.h"
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+    size_t n = 0;
+    while (size--) {
+        n += write(*buffer++);
+    }
+    return n;
+}
+
+size_t Print::write(const char *str)
+{
+    return write((const uint8_t *) str, strlen(str));
+}
+
+size_t Print::print(const char *str)
+{
+    return write(str);
+}
+
+size_t Print::print(char c)
+{
+    return write((uint8_t) c);
+}
+
+size_t Print::print(int n, int base)
+{
+    return print((long) n, base);
+}
+
+size_t Print::print(unsigned int n, int base)
+{
+    return print((unsigned long) n, base);
+}
+
+size_t Print::print(long n, int base)
+{
+    if (base == DEC && n < 0) {
+        return print('-') + printNumber((unsigned long) -n, base);
+    }
+    return printNumber((unsigned long) n, base);
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+    return printNumber(n, base);
+}
+
+// same output as the AVR core, which does not use printf
+size_t Print::print(float n, int digits)
+{
+    if (isnan(n)) return print("nan");
+    if (isinf(n)) return print("inf");
+    if (n > 4294967040.0f || n < -4294967040.0f) return print("ovf");
+
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.*f", digits, (double) n);
+    return print(buffer);
+}
+
+size_t Print::println()
+{
+    return write("\r\n");
+}
+
+size_t Print::println(const char *str)
+{
+    return print(str) + println();
+}
+
+size_t Print::println(long n, int base)
+{
+    return print(n, base) + println();
+}
+
+size_t Print::printNumber(unsigned long n, int base)
+{
+    char buffer[8 * sizeof(long) + 1];
+    char *str = &buffer[sizeof(buffer) - 1];
+    *str = '\0';
+
+    if (base < 2) {
+        base = 10;
+    }
+
+    do {
+        unsigned long digit = n % base;
+        n /= base;
+        *--str = digit < 10 ? '0' + digit : 'A' + digit - 10;
+    } while (n);
+
+    return write(str);
+}
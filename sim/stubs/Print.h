@@ -0,0 +1,41 @@
+/*
+ * Print.h - Host stand-in for the Arduino Print class, used by the simulator.
+ * Released into the public domain.
+ */
+
+#ifndef Print_h
+#define Print_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define DEC 10
+#define HEX 16
+
+class Print
+{
+    public:
+        virtual size_t write(uint8_t c) = 0;
+        virtual size_t write(const uint8_t *buffer, size_t size);
+        size_t write(const char *str);
+
+        // bytes that can be written without waiting, 0 if unknown
+        virtual int availableForWrite() { return 0; }
+
+        size_t print(const char *str);
+        size_t print(char c);
+        size_t print(int n, int base = DEC);
+        size_t print(unsigned int n, int base = DEC);
+        size_t print(long n, int base = DEC);
+        size_t print(unsigned long n, int base = DEC);
+        size_t print(float n, int digits = 2);
+
+        size_t println();
+        size_t println(const char *str);
+        size_t println(long n, int base = DEC);
+
+    private:
+        size_t printNumber(unsigned long n, int base);
+};
+
+#endif
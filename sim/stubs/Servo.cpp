@@ -0,0 +1,66 @@
+/*
+ * Servo.cpp - Host stand-in for the Arduino Servo library, used by the simulator.
+ * Released into the public domain.
+ */
+
+#include "Servo.h"
+#include "../Simulator.h"
+
+Servo::Servo()
+{
+    _pin = -1;
+
+    // the library's default 1500 us pulse
+    _angle = 90;
+}
+
+uint8_t Servo::attach(int pin)
+{
+    _pin = pin;
+    Sim.servoAttach(true);
+    Sim.servoWrite(_angle);
+    return 0;
+}
+
+uint8_t Servo::attach(int pin, int min, int max)
+{
+    (void) min;
+    (void) max;
+    return attach(pin);
+}
+
+void Servo::detach()
+{
+    _pin = -1;
+    Sim.servoAttach(false);
+}
+
+void Servo::write(int value)
+{
+    if (value < 0) {
+        value = 0;
+    }
+    if (value > 180) {
+        value = 180;
+    }
+
+    _angle = value;
+    if (attached()) {
+        Sim.servoWrite(_angle);
+    }
+}
+
+void Servo::writeMicroseconds(int value)
+{
+    write((value - 544) * 180 / (2400 - 544));
+}
+
+int Servo::read()
+{
+    return _angle;
+}
+
+bool Servo::attached()
+{
+    return _pin >= 0;
+}
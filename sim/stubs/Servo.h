@@ -0,0 +1,28 @@
+/*
+ * Servo.h - Host stand-in for the Arduino Servo library, used by the simulator.
+ * Released into the public domain.
+ */
+
+#ifndef Servo_h
+#define Servo_h
+
+#include <stdint.h>
+
+class Servo
+{
+    public:
+        Servo();
+        uint8_t attach(int pin);
+        uint8_t attach(int pin, int min, int max);
+        void detach();
+        void write(int value);
+        void writeMicroseconds(int value);
+        int read();
+        bool attached();
+
+    private:
+        int _pin;
+        int _angle;
+};
+
+#endif
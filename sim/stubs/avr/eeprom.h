@@ -0,0 +1,29 @@
+/*
+ * avr/eeprom.h - Host stand-in for the avr-libc EEPROM API, used by the simulator.
+ * Released into the public domain.
+ *
+ * Backed by a 1 KB array (the ATmega328P size). As on the board a byte
+ * takes ~3.4 ms to write in the background, and any access before then
+ * waits for it on the virtual clock.
+ */
+
+#ifndef _AVR_EEPROM_H_
+#define _AVR_EEPROM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <avr/io.h>
+
+uint8_t eeprom_read_byte(const uint8_t *addr);
+void eeprom_write_byte(uint8_t *addr, uint8_t value);
+void eeprom_update_byte(uint8_t *addr, uint8_t value);
+
+void eeprom_read_block(void *dst, const void *src, size_t n);
+void eeprom_write_block(const void *src, void *dst, size_t n);
+void eeprom_update_block(const void *src, void *dst, size_t n);
+
+// macros in avr-libc
+bool eeprom_is_ready();
+void eeprom_busy_wait();
+
+#endif
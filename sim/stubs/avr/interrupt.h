@@ -0,0 +1,20 @@
+/*
+ * avr/interrupt.h - Host stand-in for the avr-libc interrupt API, used by the simulator.
+ * Released into the public domain.
+ *
+ * ISR(PCINT0_vect) defines a plain function called PCINT0_vect, which the
+ * simulator calls between two steps of the virtual clock.
+ */
+
+#ifndef _AVR_INTERRUPT_H_
+#define _AVR_INTERRUPT_H_
+
+#define ISR(vector, ...) extern "C" void vector(void)
+
+void sim_sei(void);
+void sim_cli(void);
+
+#define sei() sim_sei()
+#define cli() sim_cli()
+
+#endif
@@ -0,0 +1,61 @@
+/*
+ * avr/io.h - Host stand-in for the ATmega328P registers, used by the simulator.
+ * Released into the public domain.
+ *
+ * Only the input, pin change interrupt, timer 0 compare and timer 2
+ * registers exist. The simulator keeps PINx in step with the simulated
+ * pins, raises the PCINTn_vect handlers when a masked pin changes and
+ * TIMER0_COMPA_vect every 1024 us while it is enabled, as timer 0 does
+ * on a 16 MHz board. Timer 2 always counts as with the /32 prescaler,
+ * one tick per 2 us, and raises TIMER2_OVF_vect every 512 us while it
+ * is enabled; TCNT2 can only be read.
+ */
+
+#ifndef _AVR_IO_H_
+#define _AVR_IO_H_
+
+#include <stdint.h>
+
+// last EEPROM address, 1 KB on the ATmega328P
+#define E2END 0x3FF
+
+extern volatile uint8_t PINB;
+extern volatile uint8_t PINC;
+extern volatile uint8_t PIND;
+
+extern volatile uint8_t PCICR;
+extern volatile uint8_t PCIFR;
+extern volatile uint8_t PCMSK0;
+extern volatile uint8_t PCMSK1;
+extern volatile uint8_t PCMSK2;
+
+#define PCIE0 0
+#define PCIE1 1
+#define PCIE2 2
+
+#define PCIF0 0
+#define PCIF1 1
+#define PCIF2 2
+
+extern volatile uint8_t TIMSK0;
+extern volatile uint8_t TIFR0;
+extern volatile uint8_t OCR0A;
+
+#define OCIE0A 1
+#define OCF0A 1
+
+extern volatile uint8_t TCCR2A;
+extern volatile uint8_t TCCR2B;
+extern volatile uint8_t TIMSK2;
+extern volatile uint8_t TIFR2;
+
+uint8_t sim_timer2_count(void);
+#define TCNT2 (sim_timer2_count())
+
+#define CS20 0
+#define CS21 1
+#define CS22 2
+#define TOIE2 0
+#define TOV2 0
+
+#endif
@@ -0,0 +1,26 @@
+/*
+ * avr/pgmspace.h - Host stand-in for avr-libc program memory access, used by the simulator.
+ * Released into the public domain.
+ *
+ * There is one address space on the host, so flash data is ordinary const
+ * data and the _P functions are their plain counterparts.
+ */
+
+#ifndef __PGMSPACE_H_
+#define __PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+
+#define pgm_read_byte(address) (*(const uint8_t *) (address))
+#define pgm_read_word(address) (*(const uint16_t *) (address))
+
+#define memcpy_P memcpy
+#define strlen_P strlen
+#define strcpy_P strcpy
+
+#endif
@@ -0,0 +1,61 @@
+/*
+ * eeprom.cpp - Host stand-in for the avr-libc EEPROM API, used by the simulator.
+ * Released into the public domain.
+ */
+
+#include "avr/eeprom.h"
+#include "../Simulator.h"
+
+uint8_t eeprom_read_byte(const uint8_t *addr)
+{
+    return Sim.eepromRead((unsigned int) (uintptr_t) addr);
+}
+
+void eeprom_write_byte(uint8_t *addr, uint8_t value)
+{
+    Sim.eepromWrite((unsigned int) (uintptr_t) addr, value);
+}
+
+void eeprom_update_byte(uint8_t *addr, uint8_t value)
+{
+    if (eeprom_read_byte(addr) != value) {
+        eeprom_write_byte(addr, value);
+    }
+}
+
+bool eeprom_is_ready()
+{
+    return Sim.eepromIsReady();
+}
+
+void eeprom_busy_wait()
+{
+    Sim.eepromWait();
+}
+
+void eeprom_read_block(void *dst, const void *src, size_t n)
+{
+    uint8_t *d = (uint8_t *) dst;
+    const uint8_t *s = (const uint8_t *) src;
+    while (n--) {
+        *d++ = eeprom_read_byte(s++);
+    }
+}
+
+void eeprom_write_block(const void *src, void *dst, size_t n)
+{
+    const uint8_t *s = (const uint8_t *) src;
+    uint8_t *d = (uint8_t *) dst;
+    while (n--) {
+        eeprom_write_byte(d++, *s++);
+    }
+}
+
+void eeprom_update_block(const void *src, void *dst, size_t n)
+{
+    const uint8_t *s = (const uint8_t *) src;
+    uint8_t *d = (uint8_t *) dst;
+    while (n--) {
+        eeprom_update_byte(d++, *s++);
+    }
+}
@@ -0,0 +1,28 @@
+/*
+ * util/crc16.h - Host stand-in for the avr-libc CRC routines, used by the simulator.
+ * Released into the public domain.
+ *
+ * The C equivalent given in the avr-libc documentation.
+ */
+
+#ifndef _UTIL_CRC16_H_
+#define _UTIL_CRC16_H_
+
+#include <stdint.h>
+
+// CRC-16 (polynomial 0xA001, reflected)
+static inline uint16_t _crc16_update(uint16_t crc, uint8_t a)
+{
+    crc ^= a;
+    for (int i = 0; i < 8; ++i) {
+        if (crc & 1) {
+            crc = (crc >> 1) ^ 0xA001;
+        }
+        else {
+            crc = (crc >> 1);
+        }
+    }
+    return crc;
+}
+
+#endif
@@ -0,0 +1,99 @@
+/*
+ * PourTelemetry.h - What the sketch reports over Serial, see lib/Telemetry.
+ * Released into the public domain.
+ *
+ * Also read by sim/decode-telemetry.cpp on a host, so the records are
+ * laid out as they go over the wire: packed, little endian, and float
+ * for what is a double on the AVR.
+ */
+
+#ifndef PourTelemetry_h
+#define PourTelemetry_h
+
+#include <stdint.h>
+
+#define POUR_TELEMETRY_BAUD 115200
+
+// record types
+#define TELEMETRY_POUR 1
+#define TELEMETRY_CURVE 2
+#define TELEMETRY_HISTORY 3
+#define TELEMETRY_PROFILE 4
+#define TELEMETRY_MEMORY 5
+
+// pour_telemetry_t flags
+#define POUR_TELEMETRY_INTERRUPTED 1
+#define POUR_TELEMETRY_EMPTY 2
+
+// history_telemetry_t only: the first pour since power-on
+#define POUR_TELEMETRY_POWER_ON 4
+
+/*
+ * One pour, sent once the water has stopped. Times in milliseconds;
+ * predictedTimeToStraw is -1 when there was nothing to go by, and
+ * plannedWet is what the sensor was to be wet for before correction.
+ */
+typedef struct {
+    uint32_t start;
+    uint16_t timeToStraw;
+    int16_t predictedTimeToStraw;
+    uint16_t plannedWet;
+    uint16_t wet;
+    uint16_t down;
+    int16_t correction;
+    uint8_t units;
+    uint8_t gaps;
+    uint8_t flags;
+} __attribute__((packed)) pour_telemetry_t;
+
+/*
+ * The curve in use, whenever it changes: after a calibration and when
+ * it is loaded at power-on. Only as many params as the model has are
+ * sent, the record length tells how many.
+ */
+#define CURVE_TELEMETRY_MAX_PARAMS 8
+
+typedef struct {
+    uint8_t pointCount;
+    float params[CURVE_TELEMETRY_MAX_PARAMS];
+} __attribute__((packed)) curve_telemetry_t;
+
+/*
+ * A pour from the history kept in EEPROM, sent oldest first after
+ * power-on. minutesBefore is since the pour before, or since power-on
+ * with POUR_TELEMETRY_POWER_ON; times in milliseconds, as stored: to
+ * 4 ms for timeToStraw, 8 ms for down. Flags as in pour_telemetry_t.
+ */
+typedef struct {
+    uint16_t minutesBefore;
+    uint8_t units;
+    uint8_t flags;
+    uint16_t timeToStraw;
+    uint32_t down;
+} __attribute__((packed)) history_telemetry_t;
+
+/*
+ * RAM, in bytes, sent with every curve: free between the heap and the
+ * stack when sent, never reached by the stack since power-on, and the
+ * most the stack has taken. See lib/MemoryMonitor.
+ */
+typedef struct {
+    uint16_t freeMemory;
+    uint16_t unusedStack;
+    uint16_t stackHighWater;
+} __attribute__((packed)) memory_telemetry_t;
+
+/*
+ * A profile slot, in builds with -DPROFILING: the histogram and the
+ * longest time, see lib/Profiler. Bucket i counts times under 16 us
+ * << 2i, the last one the rest.
+ */
+#define PROFILE_TELEMETRY_BUCKETS 8
+
+typedef struct {
+    uint8_t slot;
+    uint16_t buckets[PROFILE_TELEMETRY_BUCKETS];
+    uint32_t maxMicros;
+} __attribute__((packed)) profile_telemetry_t;
+
+#endif
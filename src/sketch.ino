@@ -2,250 +2,932 @@
 #include <LiquidCrystal.h>
 #include <LcdManager.h>
 #include <CurveFitting.h>
-#include <avr/eeprom.h>
-
-#define BUTTON1 1
-#define BUTTON2 2
-#define BUTTON3 3
+#include <TaskScheduler.h>
+#include <WaterSensor.h>
+#include <ButtonScanner.h>
+#include <RecordStore.h>
+#include <ServoMotion.h>
+#include <MessageBus.h>
+#include <Telemetry.h>
+#include <HistoryLog.h>
+#include <Profiler.h>
+#include <MemoryMonitor.h>
+#include "PourTelemetry.h"
+
+// how often the tasks run
+#define LCD_LOOP_MILLIS 1
+#define WATER_POLL_MILLIS 1
+#define POUR_SAMPLE_MILLIS 50
+
+/*
+ * Closed loop pouring: a pour dry for longer than POUR_MAX_DRY_MILLIS
+ * in all is given up. After the straw is lifted the sensor is watched
+ * for up to POUR_MAX_TAIL_MILLIS, and a part POUR_CORRECTION_GAIN of
+ * how much longer than planned it was wet goes into the correction.
+ */
+#define POUR_MAX_DRY_MILLIS 2000
+#define POUR_MAX_TAIL_MILLIS 1500
+#define POUR_CORRECTION_GAIN 0.25
+#define POUR_CORRECTION_MAX_MILLIS 1000
+#define POUR_CORRECTION_SAVE_MILLIS 10
+
+/*
+ * Time to straw is predicted before the straw goes down, from the last
+ * pour and how much it grows per unit, smoothed by POUR_PREDICTION_GAIN.
+ * A measurement within POUR_PREDICTION_TOLERANCE_MILLIS keeps the hold
+ * time worked out beforehand. No water after POUR_EMPTY_FACTOR times
+ * the prediction, or the slowest calibration point without one, means
+ * the reservoir is empty.
+ */
+#define POUR_PREDICTION_GAIN 0.5
+#define POUR_PREDICTION_TOLERANCE_MILLIS 20
+#define POUR_EMPTY_FACTOR 2
+#define POUR_EMPTY_DEFAULT_MILLIS 5000
+
+/*
+ * Pours and curve changes are reported over Serial, see PourTelemetry.h.
+ * The last TELEMETRY_CAPACITY records are kept until the line takes
+ * them, which it only gets to between pours.
+ */
+#define TELEMETRY_CAPACITY 4
+#define TELEMETRY_SEND_MILLIS 10
+
+// records go to EEPROM a byte at a time, each takes ~3.4 ms to write
+#define EEPROM_WRITE_MILLIS 4
+
+/*
+ * Every pour also goes into a log in EEPROM, see HistoryLog, kept
+ * across power cycles and sent over Serial after each power-on. Times
+ * are stored coarser than the telemetry has them, to take fewer bytes.
+ */
+#define HISTORY_BLOCK_SIZE 32
+#define HISTORY_TIME_TO_STRAW_STEP_MILLIS 4
+#define HISTORY_DOWN_STEP_MILLIS 8
+
+// in builds with -DPROFILING, the profile goes out over Serial this often
+#define PROFILE_SEND_MILLIS 60000UL
+
+/*
+ * Straw positions, and how the servo moves between them: degrees per
+ * second and degrees per second squared. Both ways are quick: timing
+ * starts when the straw goes down, and it pours for as long as it is
+ * still in the water on the way up.
+ */
+#define MOTOR_UP_DEGREES 0
+#define MOTOR_DOWN_DEGREES 90
+#define MOTOR_DOWN_SPEED 360
+#define MOTOR_DOWN_ACCELERATION 3600
+#define MOTOR_UP_SPEED 360
+#define MOTOR_UP_ACCELERATION 3600
 
 LiquidCrystal lcd(5, 6, 10, 11, 12, 8);
 
-// here we should first check if we actually need calibration
-LcdManager LcdManagerInstance(&lcd, onMessage);
-
 const int pinWaterPassingSensor = 9;
 const int ledWaterPassing = 13;
 
 const int pinMotor = 2;
-const int pinButton1 = 3;
-const int pinButton2 = 4;
-const int pinButton3 = 7;
 
-double calibrationPoints[50][2];
-int calibrationPointsSize = 0;
+// buttons 1, 2, 3: all on port D (PD3, PD4, PD7)
+const uint8_t pinButtons[] = { 3, 4, 7 };
+ButtonScanner Buttons(pinButtons, 3);
 
-Servo Motor;
-CurveFitting CurveFittingInstance;
+// messages posted by the LcdManager, handled from loop()
+MessageQueue Messages;
 
-void onMessage(message_t action, void *param) {
-    /* for loading/saving in the eeprom */
-    double aParam, bParam, cParam;
+// here we should first check if we actually need calibration
+LcdManager LcdManagerInstance(&lcd, &Buttons, &Messages);
+
+// pin 9 is PB1, its changes raise PCINT0_vect
+WaterSensor WaterSensorInstance(pinWaterPassingSensor);
+
+// a calibration fitting worse than this is not used
+#define CALIBRATION_MAX_RMS_MILLIS 150.0
+#define CALIBRATION_MAX_CONDITION 1e6
+
+/*
+ * Stack the fit may take below a message handler, with room for an
+ * interrupt on top: refine() and solveLinear3() have some 200 bytes of
+ * locals, the rest is call frames and the float library. A point or
+ * the end of a calibration is refused with less free RAM than this.
+ * See MemoryMonitor::getStackHighWater() after a calibration when the
+ * model changes.
+ */
+#define CALIBRATION_FIT_STACK_BYTES 384
+
+// the model pour durations are fitted with: ExponentialModel,
+// QuadraticModel or PiecewiseLinearModel
+typedef ExponentialModel PourModel;
+
+// 4 bytes each, see curve_point_t; a calibration takes far fewer
+#define CALIBRATION_POINTS_CAPACITY 16
+
+/*
+ * The calibration in use, as kept in EEPROM. Only the points in use are
+ * saved. Bump CALIBRATION_RECORD_VERSION when this or PourModel changes,
+ * older records are then ignored.
+ */
+#define CALIBRATION_RECORD_VERSION 2
+typedef struct {
+    float params[PourModel::PARAM_COUNT];
+    uint8_t pointCount;
+    curve_point_t points[CALIBRATION_POINTS_CAPACITY];
+} calibration_record_t;
+
+calibration_record_t calibration;
+
+// the points of a calibration under way, in calibration once accepted
+curve_point_t calibrationPoints[CALIBRATION_POINTS_CAPACITY];
+
+// what the closed loop pour has learnt, see updatePourCorrection()
+#define POUR_RECORD_VERSION 1
+typedef struct {
+    int16_t correctionMillis;
+} pour_record_t;
+
+#define SETTINGS_RECORD_VERSION 1
+#define SCHEDULE_RECORD_VERSION 2
+#define HISTORY_RECORD_VERSION 1
+
+/*
+ * EEPROM: two calibration slots, eight for the settings, which change
+ * when someone sets them, eight for the pour correction, which settles
+ * after a few pours, eight for the automatic mode checkpoints, which
+ * are written every few minutes, then as many history blocks as fit.
+ */
+#define CALIBRATION_SLOT_SIZE (sizeof(record_header_t) + sizeof(calibration_record_t))
+#define SETTINGS_START (2 * CALIBRATION_SLOT_SIZE)
+#define SETTINGS_SLOT_SIZE (sizeof(record_header_t) + sizeof(schedule_settings_t))
+#define POUR_START (SETTINGS_START + 8 * SETTINGS_SLOT_SIZE)
+#define POUR_SLOT_SIZE (sizeof(record_header_t) + sizeof(pour_record_t))
+#define SCHEDULE_START (POUR_START + 8 * POUR_SLOT_SIZE)
+#define SCHEDULE_SLOT_SIZE (sizeof(record_header_t) + sizeof(schedule_state_t))
+#define HISTORY_START (SCHEDULE_START + 8 * SCHEDULE_SLOT_SIZE)
+
+RecordStore CalibrationStore(0, 2, CALIBRATION_SLOT_SIZE, CALIBRATION_RECORD_VERSION);
+RecordStore SettingsStore(SETTINGS_START, 8, SETTINGS_SLOT_SIZE, SETTINGS_RECORD_VERSION);
+RecordStore PourStore(POUR_START, 8, POUR_SLOT_SIZE, POUR_RECORD_VERSION);
+RecordStore ScheduleStore(SCHEDULE_START, 8, SCHEDULE_SLOT_SIZE, SCHEDULE_RECORD_VERSION);
+HistoryLog PourHistory(HISTORY_START, (E2END + 1 - HISTORY_START) / HISTORY_BLOCK_SIZE,
+    HISTORY_BLOCK_SIZE, HISTORY_RECORD_VERSION);
+
+// records on their way to EEPROM, see saveRecord(); calibration goes
+// from where it is
+struct {
+    schedule_settings_t settings;
+    schedule_state_t schedule;
+    pour_record_t pour;
+} saving;
+
+// what each history entry holds, in HistoryLog fields
+enum history_field_t {
+    HISTORY_MINUTES_BEFORE,
+    HISTORY_UNITS_FLAGS,
+    HISTORY_TIME_TO_STRAW,
+    HISTORY_DOWN
+};
 
-    /* for MSG_POUR_ONE_UNIT */
+Servo Motor;
+ServoMotion Motion(&Motor, pinMotor);
+CurveFitter<PourModel> CurveFittingInstance;
+// refitted after every stored point while calibrating
+CurveFitter<PourModel> CalibrationFit;
+TaskScheduler Scheduler;
+
+#define TELEMETRY_CURVE_SIZE \
+    (offsetof(curve_telemetry_t, params) + PourModel::PARAM_COUNT * sizeof(float))
+#define TELEMETRY_LARGER(a, b) ((a) > (b) ? (a) : (b))
+#ifdef PROFILING
+#define TELEMETRY_RECORD_SIZE TELEMETRY_LARGER(TELEMETRY_LARGER( \
+    sizeof(pour_telemetry_t), TELEMETRY_CURVE_SIZE), sizeof(profile_telemetry_t))
+#else
+#define TELEMETRY_RECORD_SIZE TELEMETRY_LARGER(sizeof(pour_telemetry_t), TELEMETRY_CURVE_SIZE)
+#endif
+static_assert(PourModel::PARAM_COUNT <= CURVE_TELEMETRY_MAX_PARAMS,
+    "PourModel has more params than curve_telemetry_t");
+static_assert(sizeof(history_telemetry_t) <= TELEMETRY_RECORD_SIZE,
+    "history_telemetry_t does not fit the telemetry ring");
+#ifdef PROFILING
+static_assert(PROFILE_BUCKETS == PROFILE_TELEMETRY_BUCKETS,
+    "profile_telemetry_t does not match the Profiler buckets");
+#endif
+
+uint8_t telemetryStorage[TELEMETRY_CAPACITY * TELEMETRY_SLOT_SIZE(TELEMETRY_RECORD_SIZE)];
+Telemetry TelemetryInstance(telemetryStorage, TELEMETRY_RECORD_SIZE, TELEMETRY_CAPACITY);
+
+// the history as it goes out over Serial after power-on
+history_cursor_t historyDump;
+
+// when the last pour was, for the next history entry
+struct {
+    unsigned long lastPourMillis;
+    bool poured;
+} history = { 0, false };
+
+/* for msg_pour_units_t, which runs as pourTask */
+enum pour_state_t {
+    POUR_IDLE,
+    POUR_WAIT_WATER,
+    POUR_HOLD,
+    POUR_WAIT_DRY
+};
+
+struct {
+    pour_state_t state;
     unsigned long timePouring;
-    unsigned long timeBeforeStraw;
-    unsigned long timeToStraw;
-    unsigned long howLong;
-    unsigned long diff;
+    unsigned long timeLifted;
+    uint8_t units;
 
-    switch (action) {
+    // how long the sensor should be wet, and whether it ran dry
+    double wetMillis;
+    bool interrupted;
 
-        case MSG_INIT_MOTOR:
-            Motor.write(0);
-            break;
+    // taken off wetMillis when to lift the straw, for the water still
+    // coming on the way up
+    double correctionMillis;
+    int16_t savedCorrectionMillis;
 
-        case MSG_MOTOR_DOWN:
-            Motor.write(90);
-            break;
+    // the previous pour, to learn how much one unit adds to time to straw
+    double lastTimeToStraw;
+    uint8_t lastUnits;
+    double timeToStrawPerUnit;
 
-        case MSG_IS_WATER_POURING:
-            *((bool*) param) = isWaterFlowing();
-            break;
+    // what this pour was expected to be, -1 when there was no telling
+    double predictedTimeToStraw;
+    unsigned long emptyAfterMillis;
+    bool reservoirEmpty;
+} pour = { POUR_IDLE, 0, 0, 0, 0, false, 0, 0, 0, 0, 0, -1, 0, false };
 
-        case MSG_GET_PARAM_A:
-            *((double*) param) = CurveFittingInstance.getEstimatedParameter(0);
-            break;
-        case MSG_GET_PARAM_B:
-            *((double*) param) = CurveFittingInstance.getEstimatedParameter(1);
-            break;
-        case MSG_GET_PARAM_C:
-            *((double*) param) = CurveFittingInstance.getEstimatedParameter(2);
-            break;
 
-        case MSG_POUR_ONE_UNIT:
+void initMotor() {
+    Motion.begin(MOTOR_UP_DEGREES);
+    Scheduler.schedule(motorTask, NULL, 0);
+}
 
-            if (false == CurveFittingInstance.isCurveFitted()) {
-                lcd.clear();
-                lcd.setCursor(0, 0);
-                lcd.print("ERROR!");
-                lcd.setCursor(0, 1);
-                
-                double paramA, paramB, paramC;
+void strawDown() {
+    Motion.setProfile(MOTOR_DOWN_SPEED, MOTOR_DOWN_ACCELERATION);
+    Motion.moveTo(MOTOR_DOWN_DEGREES);
+    Scheduler.schedule(motorTask, NULL, 0);
 
-                onMessage(MSG_GET_PARAM_A, &paramA);
-                onMessage(MSG_GET_PARAM_B, &paramB);
-                onMessage(MSG_GET_PARAM_C, &paramC);
+    // time to straw is measured from here
+    WaterSensorInstance.arm();
+}
 
-                lcd.print(paramA);
+void strawUp() {
+    Motion.setProfile(MOTOR_UP_SPEED, MOTOR_UP_ACCELERATION);
+    Motion.moveTo(MOTOR_UP_DEGREES);
+    Scheduler.schedule(motorTask, NULL, 0);
+}
 
-                return;
-            }
+/*
+ * What the LcdManager asks for, one handler per message type; see
+ * LcdManager.h for the messages and MessageBus.h for how they get here.
+ */
+template <> void onMessage(msg_motor_down_t &message) {
+    strawDown();
+}
+
+template <> void onMessage(msg_motor_up_t &message) {
+    strawUp();
+}
+
+template <> void onMessage(msg_get_time_to_straw_t &message) {
+    if (WaterSensorInstance.hasFlowed()) {
+        message.timeToStrawMillis = WaterSensorInstance.getTimeToFlowMicros() / 1000.0;
+    }
+    else {
+        message.timeToStrawMillis = -1;
+    }
+}
 
-            // begin pouring
-            timePouring = millis();
+template <> void onMessage(msg_get_param_count_t &message) {
+    message.count = CurveFittingInstance.getParamCount();
+}
 
-            // motor goes down for exactly one unit time
-            onMessage(MSG_MOTOR_DOWN, (void *) NULL);
+template <> void onMessage(msg_get_param_t &message) {
+    message.value = CurveFittingInstance.getEstimatedParameter(message.index);
+}
 
-            // maybe the water goes down so fast and we want to turn the led on
-            realtimeLoop();
+template <> void onMessage(msg_get_history_count_t &message) {
+    message.count = PourHistory.getCount();
+}
 
-            // how long does the time to straw sensor to light up?
-            timeBeforeStraw = millis();
-            while (!isWaterFlowing()) {
-                delay(20);
-                realtimeLoop();
-            }
-            timeToStraw = millis() - timeBeforeStraw;
+// the log only reads forwards, from the oldest
+template <> void onMessage(msg_get_history_entry_t &message) {
+    uint16_t count = PourHistory.getCount();
+    message.found = message.index < count;
+    if (!message.found) {
+        return;
+    }
 
-            // Estimate how long to hold the straw down using the interpolation function
-            // f(timeToStraw) = a + b * e^(c * timeToStraw)
-            howLong = (unsigned long) CurveFittingInstance.estimate((double)timeToStraw);
+    history_cursor_t cursor;
+    history_telemetry_t entry;
+    PourHistory.rewind(&cursor);
+    uint16_t toRead = count - message.index;
+    do {
+        if (!readHistory(&cursor, &entry)) {
+            message.found = false;
+            return;
+        }
+    } while (--toRead > 0);
+
+    message.minutesBefore = entry.minutesBefore;
+    message.units = entry.units;
+    message.afterPowerOn = entry.flags & POUR_TELEMETRY_POWER_ON;
+    message.interrupted = entry.flags & POUR_TELEMETRY_INTERRUPTED;
+    message.empty = entry.flags & POUR_TELEMETRY_EMPTY;
+    message.timeToStrawMillis = entry.timeToStraw;
+    message.downMillis = entry.down;
+}
 
-            // wait until howLongHas passed
-            do {
-                realtimeLoop();
-                diff = millis() - timePouring;
-                delay(20);
-            } while (diff < howLong);
+template <> void onMessage(msg_pour_units_t &message) {
+    message.accepted = false;
+    if (false == CurveFittingInstance.isCurveFitted()) {
+        LcdManagerInstance.showMessage(PSTR("ERROR! No curve"), 2000);
+        return;
+    }
 
-            realtimeLoop();
+    // one at a time: the sensor is timing this one from when it was armed
+    if (message.units == 0 || pour.state != POUR_IDLE || Motion.isMoving()) {
+        return;
+    }
+    message.accepted = true;
+    pour.units = message.units;
 
-            onMessage(MSG_MOTOR_UP, (void *) NULL);
-            break;
+    // worked out while the straw is still up
+    predictPour();
 
-        case MSG_CALIBRATION_BEGIN:
-            calibrationPointsSize = 0;
-            break;
+    // begin pouring
+    pour.timePouring = millis();
+    pour.interrupted = false;
+
+    // motor goes down once for all the units
+    strawDown();
+
+    // how long does the time to straw sensor to light up?
+    pour.state = POUR_WAIT_WATER;
+    Scheduler.schedule(pourTask, NULL, 0);
+}
+
+template <> void onMessage(msg_is_pour_in_progress_t &message) {
+    message.inProgress = pour.state != POUR_IDLE ||
+        Motion.isMoving();
+}
 
-        case MSG_CALIBRATION_IS_VALID:
-            // the first time is always valid
-            if (calibrationPointsSize == 0) {
-                *((bool *)((void **)param)[1]) = true;
+template <> void onMessage(msg_is_reservoir_empty_t &message) {
+    message.empty = pour.reservoirEmpty;
+}
+
+template <> void onMessage(msg_calibration_begin_t &message) {
+    CalibrationFit.beginFit(calibrationPoints, CALIBRATION_POINTS_CAPACITY);
+}
+
+bool hasMemoryForFit() {
+    return MemoryMonitor::getFreeMemory() >= CALIBRATION_FIT_STACK_BYTES;
+}
+
+template <> void onMessage(msg_calibration_is_valid_t &message) {
+    // storing it refits the curve
+    message.lowMemory = !hasMemoryForFit();
+    if (message.lowMemory) {
+        message.valid = false;
+        return;
+    }
+
+    // the first time is always valid
+    int count = CalibrationFit.getPointCount();
+    if (count == 0) {
+        message.valid = true;
+        return;
+    }
+
+    // WRT to previous pouring we must meet:
+    // - higher timeToStraw
+    // - longer duration
+    message.valid =
+        calibrationPoints[count-1].x < message.timeToStrawMillis &&
+        calibrationPoints[count-1].y < message.strawDownMillis;
+}
+
+template <> void onMessage(msg_calibration_store_point_t &message) {
+    CalibrationFit.addPoint(message.timeToStrawMillis, message.strawDownMillis);
+}
+
+template <> void onMessage(msg_calibration_end_t &message) {
+    double params[PourModel::PARAM_COUNT];
+
+    // the curve was fitted as the points came in
+    message.accepted = false;
+    message.lowMemory = false;
+    if (!CalibrationFit.isCurveFitted()) {
+        return;
+    }
+
+    message.lowMemory = !hasMemoryForFit();
+    if (message.lowMemory) {
+        return;
+    }
+
+    fit_quality_t quality;
+    CalibrationFit.refine();
+    CalibrationFit.getFitQuality(&quality);
+
+    // written so that NaN fails too
+    if (!(quality.rmsResidual <= CALIBRATION_MAX_RMS_MILLIS &&
+          quality.condition <= CALIBRATION_MAX_CONDITION)) {
+        return;
+    }
+
+    // until now the curve in use kept its own points
+    calibration.pointCount = CalibrationFit.getPointCount();
+    memcpy(calibration.points, calibrationPoints,
+        calibration.pointCount * sizeof(curve_point_t));
+
+    for (int i=0; i<PourModel::PARAM_COUNT; i++) {
+        params[i] = CalibrationFit.getEstimatedParameter(i);
+    }
+    CurveFittingInstance.setRange(
+        calibration.points[0].x,
+        calibration.points[calibration.pointCount-1].x
+    );
+    CurveFittingInstance.setParams(params);
+    message.accepted = true;
+    recordCurve();
+}
+
+template <> void onMessage(msg_calibration_save_t &message) {
+    // the points are already in the record
+    for (int i=0; i<PourModel::PARAM_COUNT; i++) {
+        calibration.params[i] = CurveFittingInstance.getEstimatedParameter(i);
+    }
+    saveRecord(&CalibrationStore, &calibration,
+        offsetof(calibration_record_t, points) +
+        calibration.pointCount * sizeof(curve_point_t));
+}
+
+template <> void onMessage(msg_calibration_load_t &message) {
+    double params[PourModel::PARAM_COUNT];
+    uint16_t length;
+
+    message.loaded = false;
+
+    length = CalibrationStore.getLength();
+    if (false == CalibrationStore.read(&calibration, sizeof(calibration)) ||
+        length < offsetof(calibration_record_t, points) ||
+        length != offsetof(calibration_record_t, points) +
+            calibration.pointCount * sizeof(curve_point_t)) {
+        calibration.pointCount = 0;
+        return;
+    }
+
+    for (int i=0; i<PourModel::PARAM_COUNT; i++) {
+        params[i] = calibration.params[i];
+    }
+    if (calibration.pointCount > 0) {
+        CurveFittingInstance.setRange(
+            calibration.points[0].x,
+            calibration.points[calibration.pointCount-1].x
+        );
+    }
+    CurveFittingInstance.setParams(params);
+    message.loaded = true;
+    recordCurve();
+}
+
+template <> void onMessage(msg_is_calibrated_t &message) {
+    message.calibrated = CurveFittingInstance.isCurveFitted();
+}
+
+template <> void onMessage(msg_settings_save_t &message) {
+    saving.settings = message.settings;
+    saveRecord(&SettingsStore, &saving.settings, sizeof(schedule_settings_t));
+}
+
+template <> void onMessage(msg_settings_load_t &message) {
+    // left as they are if none were saved
+    SettingsStore.read(&message.settings, sizeof(schedule_settings_t));
+}
+
+template <> void onMessage(msg_schedule_save_t &message) {
+    saving.schedule = message.state;
+    saveRecord(&ScheduleStore, &saving.schedule, sizeof(schedule_state_t));
+}
+
+template <> void onMessage(msg_schedule_load_t &message) {
+    ScheduleStore.read(&message.state, sizeof(schedule_state_t));
+}
+
+/*
+ * Holds the straw down for the time estimated from how long the water
+ * took to reach the straw sensor, then lifts it.
+ *
+ * Several units are poured with the straw down once. The curve gives
+ * f(t), the time the straw stays down for one unit when water takes t
+ * to reach it, so a unit alone flows for f(t) - t. The level drops a
+ * little with every unit, and so does the flow, so unit k flows for
+ * f(t_k) - t_k with t_k = t + k * timeToStrawPerUnit, which is learnt
+ * from how time to straw grew between the last two pours.
+ *
+ * What is timed is how long the sensor is wet, so an air gap makes the
+ * straw stay down for longer. Water keeps coming for a moment while
+ * the straw goes up; that is measured too, see updatePourCorrection().
+ */
+uint32_t pourTask(void *context) {
+    PROFILE(PROFILE_POUR);
+
+    double timeToStraw;
+    double toGo;
+
+    switch (pour.state) {
+        case POUR_WAIT_WATER:
+            // the edge time comes from the interrupt, polling only picks it up
+            if (!WaterSensorInstance.hasFlowed()) {
+                if (millis() - pour.timePouring < pour.emptyAfterMillis) {
+                    return WATER_POLL_MILLIS;
+                }
+
+                strawUp();
+                pour.timeLifted = millis();
+                pour.reservoirEmpty = true;
+                pour.state = POUR_IDLE;
+                recordPour(POUR_TELEMETRY_EMPTY);
+                LcdManagerInstance.showMessage(PSTR("Refill water!"), 5000);
+                break;
+            }
+            pour.reservoirEmpty = false;
+            timeToStraw = WaterSensorInstance.getTimeToFlowMicros() / 1000.0;
+
+            // a refill in between makes it shorter, keep what we had then
+            if (pour.lastUnits > 0 && timeToStraw > pour.lastTimeToStraw) {
+                double perUnit = (timeToStraw - pour.lastTimeToStraw) / pour.lastUnits;
+                pour.timeToStrawPerUnit = pour.timeToStrawPerUnit == 0 ? perUnit :
+                    pour.timeToStrawPerUnit + POUR_PREDICTION_GAIN * (perUnit - pour.timeToStrawPerUnit);
+            }
+            pour.lastTimeToStraw = timeToStraw;
+            pour.lastUnits = pour.units;
+
+            if (pour.predictedTimeToStraw < 0 ||
+                fabs(timeToStraw - pour.predictedTimeToStraw) > POUR_PREDICTION_TOLERANCE_MILLIS) {
+                pour.wetMillis = estimateWetMillis(timeToStraw, pour.units);
             }
-            else {
-                double timeToStraw = ((double *)((void **)param)[0])[0];
-                double strawDownTime = ((double *)((void **)param)[0])[1];
-                // WRT to previous pouring we must meet:
-                // - higher timeToStraw
-                // - longer duration
+            pour.state = POUR_HOLD;
 
-                if (calibrationPoints[calibrationPointsSize-1][0] < timeToStraw &&
-                    calibrationPoints[calibrationPointsSize-1][1] < strawDownTime) {
+            // fall through
 
-                    *((bool *)((void **)param)[1]) = true;
+        case POUR_HOLD:
+            toGo = pour.wetMillis - pour.correctionMillis -
+                WaterSensorInstance.getWetMicros() / 1000.0;
+            if (toGo > 0) {
+                if (isWaterFlowing()) {
+                    return toGo < POUR_SAMPLE_MILLIS ? (uint32_t) toGo + 1 : POUR_SAMPLE_MILLIS;
                 }
-                else {
-                    *((bool *)((void **)param)[1]) = false;
+
+                // an air gap, unless it goes on: then the reservoir is empty
+                if (WaterSensorInstance.getDryMicros() < POUR_MAX_DRY_MILLIS * 1000UL) {
+                    return WATER_POLL_MILLIS;
                 }
+                pour.interrupted = true;
             }
 
-            break;
-            
+            strawUp();
+            pour.timeLifted = millis();
+            pour.state = POUR_WAIT_DRY;
+            return WATER_POLL_MILLIS;
 
-        case MSG_CALIBRATION_STORE_POINT:
-            calibrationPoints[calibrationPointsSize][0] = (((double *) param)[0]);
-            calibrationPoints[calibrationPointsSize][1] = (((double *) param)[1]);
-            calibrationPointsSize++;
+        case POUR_WAIT_DRY:
+            if (isWaterFlowing() && millis() - pour.timeLifted < POUR_MAX_TAIL_MILLIS) {
+                return WATER_POLL_MILLIS;
+            }
 
-            break;
+            // with the correction this pour was made with
+            recordPour(pour.interrupted ? POUR_TELEMETRY_INTERRUPTED : 0);
 
-        case MSG_CALIBRATION_END:
-            // perform exponential curve fitting
-            CurveFittingInstance.fitPoints(
-                calibrationPoints,
-                calibrationPointsSize
-            );
+            if (!pour.interrupted) {
+                updatePourCorrection(
+                    WaterSensorInstance.getWetMicros() / 1000.0 - pour.wetMillis
+                );
+            }
+            pour.state = POUR_IDLE;
             break;
 
-        case MSG_CALIBRATION_SAVE:
-            
-            // retrieve current parameters
-            onMessage(MSG_GET_PARAM_A, &aParam);
-            onMessage(MSG_GET_PARAM_B, &bParam);
-            onMessage(MSG_GET_PARAM_C, &cParam);
-            
-            eeprom_write_block((const void*)&aParam, (void*)0, sizeof(aParam));
-            eeprom_write_block((const void*)&bParam, (void*)4, sizeof(bParam));
-            eeprom_write_block((const void*)&cParam, (void*)8, sizeof(cParam));
+        case POUR_IDLE:
             break;
-            
-        case MSG_CALIBRATION_LOAD:
-            eeprom_read_block((void*)&aParam, (void*)0, sizeof(aParam));
+    }
+
+    return TASK_DONE;
+}
 
-            eeprom_read_block((void*)&bParam, (void*)4, sizeof(bParam));
+/*
+ * Estimate how long to hold the straw down using the interpolation
+ * function f(timeToStraw) = a + b * e^(c * timeToStraw), see pourTask.
+ */
+double estimateWetMillis(double timeToStraw, uint8_t units) {
+    double wetMillis = 0;
+    for (uint8_t k = 0; k < units; k++) {
+        double t = timeToStraw + k * pour.timeToStrawPerUnit;
+        wetMillis += CurveFittingInstance.estimate(t) - t;
+    }
+    return wetMillis;
+}
 
-            eeprom_read_block((void*)&cParam, (void*)8, sizeof(cParam));
+/*
+ * The reservoir drains by the same amount with every unit, so time to
+ * straw grows by about timeToStrawPerUnit a unit. Before any pour since
+ * power-on there is nothing to go by, only how slow calibration got.
+ */
+void predictPour() {
+    double reference;
+
+    if (pour.lastUnits > 0) {
+        pour.predictedTimeToStraw = pour.lastTimeToStraw +
+            pour.lastUnits * pour.timeToStrawPerUnit;
+        pour.wetMillis = estimateWetMillis(pour.predictedTimeToStraw, pour.units);
+        reference = pour.predictedTimeToStraw;
+    }
+    else {
+        pour.predictedTimeToStraw = -1;
+        reference = calibration.pointCount > 0 ?
+            calibration.points[calibration.pointCount-1].x : 0;
+    }
 
-            CurveFittingInstance.setParams(aParam, bParam, cParam);
-            break;
+    pour.emptyAfterMillis = reference > 0 ?
+        (unsigned long) (POUR_EMPTY_FACTOR * reference) : POUR_EMPTY_DEFAULT_MILLIS;
+}
 
-        case MSG_MOTOR_UP:
-            int currentPosition = 90;
-            for (int i=currentPosition; i>=0; i--) {
-              Motor.write(i);
-              realtimeLoop();
-              delay(25);
-            }  
-            break;
+/*
+ * How long the sensor stayed wet beyond plan, mostly while the straw
+ * went up, changes with the tubing, the servo and the straw. It is
+ * learnt a little at every pour and the straw lifted that much
+ * earlier. Saved when it has moved by POUR_CORRECTION_SAVE_MILLIS.
+ */
+void updatePourCorrection(double errorMillis) {
+    pour.correctionMillis = constrain(
+        pour.correctionMillis + POUR_CORRECTION_GAIN * errorMillis,
+        -POUR_CORRECTION_MAX_MILLIS,
+        POUR_CORRECTION_MAX_MILLIS
+    );
+
+    int16_t correctionMillis = (int16_t) floor(pour.correctionMillis + 0.5);
+    if (abs(correctionMillis - pour.savedCorrectionMillis) >= POUR_CORRECTION_SAVE_MILLIS) {
+        saving.pour.correctionMillis = correctionMillis;
+        saveRecord(&PourStore, &saving.pour, sizeof(pour_record_t));
+        pour.savedCorrectionMillis = correctionMillis;
+    }
+}
+
+void loadPourCorrection() {
+    pour_record_t record;
+    if (PourStore.read(&record, sizeof(record))) {
+        pour.correctionMillis = record.correctionMillis;
+        pour.savedCorrectionMillis = record.correctionMillis;
+    }
+}
+
+/*
+ * Only copied into the ring here, telemetryTask sends it.
+ */
+void recordPour(uint8_t flags) {
+    pour_telemetry_t record;
+    record.start = pour.timePouring;
+    record.timeToStraw = WaterSensorInstance.hasFlowed() ?
+        WaterSensorInstance.getTimeToFlowMicros() / 1000 : 0;
+    record.predictedTimeToStraw = pour.predictedTimeToStraw < 0 ? -1 :
+        (int16_t) floor(pour.predictedTimeToStraw + 0.5);
+    record.plannedWet = (uint16_t) floor(pour.wetMillis + 0.5);
+    record.wet = WaterSensorInstance.getWetMicros() / 1000;
+    record.down = pour.timeLifted - pour.timePouring;
+    record.correction = (int16_t) floor(pour.correctionMillis + 0.5);
+    record.units = pour.units;
+    record.gaps = WaterSensorInstance.getGapCount();
+    record.flags = flags;
+
+    TelemetryInstance.push(TELEMETRY_POUR, &record, sizeof(record));
+    Scheduler.schedule(telemetryTask, NULL, 0);
+
+    appendHistory(&record);
+}
+
+/*
+ * A few EEPROM bytes, written by eepromTask() with the straw already
+ * up. The first pour after power-on counts its minutes from then, since
+ * the clock does not know about the time the power was off.
+ */
+void appendHistory(const pour_telemetry_t *record) {
+    int16_t fields[HISTORY_LOG_FIELDS];
+    unsigned long minutes = (record->start - history.lastPourMillis) / 60000UL;
+    uint8_t flags = record->flags | (history.poured ? 0 : POUR_TELEMETRY_POWER_ON);
+
+    fields[HISTORY_MINUTES_BEFORE] = minutes < 32767 ? minutes : 32767;
+    fields[HISTORY_UNITS_FLAGS] = (record->units & 0x0F) | flags << 4;
+    fields[HISTORY_TIME_TO_STRAW] =
+        constrain(record->timeToStraw / HISTORY_TIME_TO_STRAW_STEP_MILLIS, 0, 8191);
+    fields[HISTORY_DOWN] = constrain(record->down / HISTORY_DOWN_STEP_MILLIS, 0, 8191);
+    PourHistory.append(fields);
+    Scheduler.schedule(eepromTask, NULL, 0);
+
+    history.lastPourMillis = record->start;
+    history.poured = true;
+}
+
+bool readHistory(history_cursor_t *cursor, history_telemetry_t *entry) {
+    int16_t fields[HISTORY_LOG_FIELDS];
+    if (!PourHistory.read(cursor, fields)) {
+        return false;
+    }
+
+    entry->minutesBefore = fields[HISTORY_MINUTES_BEFORE];
+    entry->units = fields[HISTORY_UNITS_FLAGS] & 0x0F;
+    entry->flags = fields[HISTORY_UNITS_FLAGS] >> 4;
+    entry->timeToStraw = fields[HISTORY_TIME_TO_STRAW] * HISTORY_TIME_TO_STRAW_STEP_MILLIS;
+    entry->down = (uint32_t) fields[HISTORY_DOWN] * HISTORY_DOWN_STEP_MILLIS;
+    return true;
+}
+
+void recordCurve() {
+    curve_telemetry_t record;
+    record.pointCount = calibration.pointCount;
+    for (int i=0; i<PourModel::PARAM_COUNT; i++) {
+        record.params[i] = CurveFittingInstance.getEstimatedParameter(i);
+    }
+
+    TelemetryInstance.push(TELEMETRY_CURVE, &record, TELEMETRY_CURVE_SIZE);
+    Scheduler.schedule(telemetryTask, NULL, 0);
+
+    // a fit has just run, about as deep as the stack goes
+    recordMemory();
+}
+
+void recordMemory() {
+    memory_telemetry_t record;
+    record.freeMemory = MemoryMonitor::getFreeMemory();
+    record.unusedStack = MemoryMonitor::getUnusedStack();
+    record.stackHighWater = MemoryMonitor::getStackHighWater();
+
+    TelemetryInstance.push(TELEMETRY_MEMORY, &record, sizeof(record));
+    Scheduler.schedule(telemetryTask, NULL, 0);
+}
+
+/*
+ * A frame at a time, whenever the straw is up and the Serial buffer has
+ * room for it, so that sending never waits and never delays a pour.
+ */
+uint32_t telemetryTask(void *context) {
+    if (pour.state == POUR_IDLE) {
+        TelemetryInstance.send(&Serial);
+    }
+    return TelemetryInstance.isEmpty() ? TASK_DONE : TELEMETRY_SEND_MILLIS;
+}
+
+/*
+ * Sends the history after power-on, which is also when a host opening
+ * the port resets the board. An entry at a time, whenever the ring is
+ * empty, so that it never pushes out a pour.
+ */
+uint32_t historyTask(void *context) {
+    if (!TelemetryInstance.isEmpty()) {
+        return TELEMETRY_SEND_MILLIS;
+    }
+
+    history_telemetry_t entry;
+    if (!readHistory(&historyDump, &entry)) {
+        return TASK_DONE;
+    }
+
+    TelemetryInstance.push(TELEMETRY_HISTORY, &entry, sizeof(entry));
+    Scheduler.schedule(telemetryTask, NULL, 0);
+    return TELEMETRY_SEND_MILLIS;
+}
+
+#ifdef PROFILING
+// the slot profileTask() sends next
+uint8_t profileSlot = 0;
+
+/*
+ * Every slot in turn, each when the ring is empty, then again a while
+ * later.
+ */
+uint32_t profileTask(void *context) {
+    if (!TelemetryInstance.isEmpty()) {
+        return TELEMETRY_SEND_MILLIS;
+    }
+
+    profile_telemetry_t record;
+    record.slot = profileSlot;
+    memcpy(record.buckets, Profile.getBuckets(profileSlot), sizeof(record.buckets));
+    record.maxMicros = Profile.getMaxMicros(profileSlot);
+    TelemetryInstance.push(TELEMETRY_PROFILE, &record, sizeof(record));
+    Scheduler.schedule(telemetryTask, NULL, 0);
+
+    if (++profileSlot < PROFILE_SLOT_COUNT) {
+        return TELEMETRY_SEND_MILLIS;
     }
+    profileSlot = 0;
+    return PROFILE_SEND_MILLIS;
+}
+#endif
+
+/*
+ * Starts writing a record, which has to stay as it is until eepromTask()
+ * is done with it. Saving it again before then starts over.
+ */
+void saveRecord(RecordStore *store, const void *record, uint16_t length) {
+    store->beginWrite(record, length);
+    Scheduler.schedule(eepromTask, NULL, 0);
+}
+
+/*
+ * Writes what it can of the records being saved without waiting for
+ * the EEPROM, so that a save never holds up the loop or a button.
+ */
+uint32_t eepromTask(void *context) {
+    bool writing = CalibrationStore.writeSome();
+    writing |= SettingsStore.writeSome();
+    writing |= PourStore.writeSome();
+    writing |= ScheduleStore.writeSome();
+    writing |= PourHistory.writeSome();
+    return writing ? EEPROM_WRITE_MILLIS : TASK_DONE;
+}
+
+/*
+ * Moves the straw along, then lets the servo go once it is idle.
+ */
+uint32_t motorTask(void *context) {
+    uint32_t next = Motion.update();
+    return next == SERVO_MOTION_IDLE ? TASK_DONE : next;
+}
+
+uint32_t lcdLoopTask(void *context) {
+    LcdManagerInstance.loop();
+    return LCD_LOOP_MILLIS;
 }
 
 // Circuit from http://www.electroschematics.com/9964/arduino-water-level-indicator-controller/
 bool isWaterFlowing() {
-    return digitalRead(pinWaterPassingSensor) == LOW;
+    return WaterSensorInstance.isFlowing();
+}
+
+ISR(PCINT0_vect) {
+    WaterSensorInstance.onPinChange();
+}
+
+// every 1.024 ms, see setup()
+ISR(TIMER0_COMPA_vect) {
+    Buttons.onTick();
 }
 
 
 void setup()
 {
+    Serial.begin(POUR_TELEMETRY_BAUD);
+
+    CalibrationStore.begin();
+    SettingsStore.begin();
+    PourStore.begin();
+    ScheduleStore.begin();
+    PourHistory.begin();
+    loadPourCorrection();
+
     LcdManagerInstance.begin();
-    Motor.attach(pinMotor);
 
     pinMode(ledWaterPassing, OUTPUT);
-    pinMode(pinWaterPassingSensor, INPUT);
+    WaterSensorInstance.begin();
 
-    pinMode(pinButton1, INPUT);
-    pinMode(pinButton2, INPUT);
-    pinMode(pinButton3, INPUT);
+    Buttons.begin();
 
     digitalWrite(ledWaterPassing, LOW);
 
-    onMessage(MSG_INIT_MOTOR, NULL);
+    initMotor();
+
+    /*
+     * Timer 0 already runs millis(); its compare A interrupt fires once per
+     * overflow period at the OCR0A count and gives us a free 1 kHz tick.
+     */
+    OCR0A = 0x80;
+    TIMSK0 |= (1 << OCIE0A);
+
+    Scheduler.schedule(lcdLoopTask, NULL, 0);
+
+    PourHistory.rewind(&historyDump);
+    Scheduler.schedule(historyTask, NULL, 0);
+
+#ifdef PROFILING
+    Profile.begin();
+    Scheduler.schedule(profileTask, NULL, PROFILE_SEND_MILLIS);
+#endif
 }
 
 void realtimeLoop() {
+    PROFILE(PROFILE_REALTIME);
+
     // update water led
     digitalWrite(ledWaterPassing, isWaterFlowing() ? HIGH : LOW);
 }
 
 void loop()
 {
-    LcdManagerInstance.loop();
+    PROFILE(PROFILE_LOOP);
 
-    realtimeLoop();
+    Scheduler.run();
+    Messages.dispatch();
 
-    if (digitalRead(pinButton1) == HIGH) {
-        LcdManagerInstance.onButtonPressed(BUTTON1);
-    }
-    else {
-        LcdManagerInstance.onButtonReleased(BUTTON1);
-    }
-    delay(25);
-
-    if (digitalRead(pinButton2) == HIGH) {
-        LcdManagerInstance.onButtonPressed(BUTTON2);
-    }
-    else {
-        LcdManagerInstance.onButtonReleased(BUTTON2);
-    }
-    delay(25);
-    
-    if (digitalRead(pinButton3) == HIGH) {
-        LcdManagerInstance.onButtonPressed(BUTTON3);
-    }
-    else {
-        LcdManagerInstance.onButtonReleased(BUTTON3);
-    }
-    delay(25);
+    realtimeLoop();
 }